@@ -1,22 +1,51 @@
 #pragma once
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <cstdlib>
-#include <future>
+#include <execution>
 #include <map>
+#include <mutex>
+#include <numeric>
 #include <string>
+#include <thread>
 #include <vector>
-#include <mutex>
-
-#include "log_duration.h"
-
 
 using namespace std::string_literals;
 
+// Словарь для параллельного накопления значений по целочисленным ключам.
+// Первые ключи попадают в хеш-таблицу с открытой адресацией без мьютексов: слот
+// захватывается сравнением с обменом, значения складываются атомарно. Когда
+// таблица заполнена, остальные ключи хранятся в корзинах под мьютексами, поэтому
+// число ключей не ограничено.
+//
+// Значение слота и признак удаления — две отдельные атомарные переменные, поэтому
+// Erase не атомарен относительно одновременного изменения того же ключа: ключ может
+// остаться с нулевым значением или оказаться удалённым вместе с прибавкой.
+// Удалять ключ следует, когда его больше никто не изменяет.
 template <typename Key, typename Value>
 class ConcurrentMap
 {
 private:
 
+    enum SlotState : uint8_t
+    {
+        EMPTY,
+        CLAIMED,
+        READY,
+        // Слот без ключа, захваченный после заполнения таблицы. Поиск на нём
+        // заканчивается: ключ дальше по цепочке лежать не может.
+        OVERFLOWED
+    };
+
+    struct Slot
+    {
+        std::atomic<uint8_t> state{ EMPTY };
+        std::atomic<bool> erased{ false };
+        Key key{};
+        std::atomic<Value> value{};
+    };
+
     struct Bucket
     {
         std::mutex bucket_mutex;
@@ -25,49 +54,262 @@ private:
 
 public:
     static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys"s);
+    static_assert(std::is_arithmetic_v<Value>, "ConcurrentMap supports only arithmetic values"s);
 
-    struct Access
+    // Ссылка на значение, поддерживающая атомарное прибавление. Для ключа из
+    // корзины держит мьютекс корзины, пока жива.
+    class ValueRef
     {
-        std::lock_guard<std::mutex> guard;
-        Value& ref_to_value;
+    public:
 
-        Access(const Key& key, Bucket& bucket)
-            :guard(bucket.bucket_mutex)
-            , ref_to_value(bucket.bucket_map[key])
+        explicit ValueRef(Slot& slot) : slot_(&slot)
         {}
+
+        ValueRef(Bucket& bucket, const Key& key)
+            : guard_(bucket.bucket_mutex)
+            , value_(&bucket.bucket_map[key])
+        {}
+
+        ValueRef& operator+=(Value delta)
+        {
+            if (slot_ == nullptr)
+            {
+                *value_ += delta;
+                return *this;
+            }
+            Value current = slot_->value.load(std::memory_order_relaxed);
+            while (!slot_->value.compare_exchange_weak(current, current + delta, std::memory_order_relaxed))
+            {
+            }
+            slot_->erased.store(false, std::memory_order_relaxed);
+            return *this;
+        }
+
+        ValueRef& operator=(Value value)
+        {
+            if (slot_ == nullptr)
+            {
+                *value_ = value;
+                return *this;
+            }
+            slot_->value.store(value, std::memory_order_relaxed);
+            slot_->erased.store(false, std::memory_order_relaxed);
+            return *this;
+        }
+
+        operator Value() const
+        {
+            return slot_ == nullptr ? *value_ : slot_->value.load(std::memory_order_relaxed);
+        }
+
+    private:
+
+        Slot* slot_ = nullptr;
+        std::unique_lock<std::mutex> guard_;
+        Value* value_ = nullptr;
+    };
+
+    struct Access
+    {
+        ValueRef ref_to_value;
     };
 
-    explicit ConcurrentMap(size_t bucket_count) :buckets_(bucket_count)
+    // Таблица без мьютексов вмещает bucket_count ключей.
+    explicit ConcurrentMap(size_t bucket_count)
+        : ConcurrentMap(bucket_count, bucket_count)
+    {}
+
+    // Таблица без мьютексов вмещает table_key_count ключей, остальные ключи
+    // распределяются по bucket_count корзинам.
+    ConcurrentMap(size_t bucket_count, size_t table_key_count)
+        : slots_(RoundUpToPowerOfTwo(std::max<size_t>(table_key_count * 2, 16)))
+        , table_key_count_(table_key_count)
+        , buckets_(std::max<size_t>(bucket_count, 1))
     {}
 
     Access operator[](const Key& key)
     {
-        auto& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
-        return { key, bucket };
+        if (Slot* slot = FindOrInsert(key))
+        {
+            return { ValueRef(*slot) };
+        }
+        return { ValueRef(GetBucket(key), key) };
     }
 
-    std::map<Key, Value> BuildOrdinaryMap()
+    void Add(const Key& key, Value delta)
     {
-        std::map<Key, Value> result;
-        for (auto& [mutex, map] : buckets_)
+        operator[](key).ref_to_value += delta;
+    }
+
+    void Erase(const Key& key)
+    {
+        bool is_in_bucket = false;
+        if (Slot* slot = Find(key, is_in_bucket))
         {
-            std::lock_guard guard(mutex);
-            result.insert(map.begin(), map.end());
+            slot->value.store(Value{}, std::memory_order_relaxed);
+            slot->erased.store(true, std::memory_order_relaxed);
         }
+        else if (is_in_bucket)
+        {
+            Bucket& bucket = GetBucket(key);
+            std::lock_guard guard(bucket.bucket_mutex);
+            bucket.bucket_map.erase(key);
+        }
+    }
+
+    // Пары ключ-значение по возрастанию ключа. Слоты просматриваются параллельно.
+    template <typename ExecutionPolicy>
+    std::vector<std::pair<Key, Value>> BuildSortedVector(ExecutionPolicy&& policy) const
+    {
+        const size_t chunk_count = std::min<size_t>(slots_.size() / 1024 + 1,
+            std::max(1u, std::thread::hardware_concurrency()) * 4);
+        const size_t chunk_size = (slots_.size() + chunk_count - 1) / chunk_count;
+
+        std::vector<std::vector<std::pair<Key, Value>>> chunks(chunk_count);
+        std::vector<size_t> chunk_indexes(chunk_count);
+        std::iota(chunk_indexes.begin(), chunk_indexes.end(), 0);
+        std::for_each(policy, chunk_indexes.begin(), chunk_indexes.end(), [&](size_t chunk_index)
+            {
+                const size_t last = std::min(slots_.size(), (chunk_index + 1) * chunk_size);
+                for (size_t i = chunk_index * chunk_size; i < last; ++i)
+                {
+                    const Slot& slot = slots_[i];
+                    if (slot.state.load(std::memory_order_acquire) == READY && !slot.erased.load(std::memory_order_relaxed))
+                    {
+                        chunks[chunk_index].push_back({ slot.key, slot.value.load(std::memory_order_relaxed) });
+                    }
+                }
+            });
 
+        std::vector<size_t> offsets(chunk_count + 1, 0);
+        for (size_t i = 0; i < chunk_count; ++i)
+        {
+            offsets[i + 1] = offsets[i] + chunks[i].size();
+        }
+        std::vector<std::pair<Key, Value>> result(offsets.back());
+        std::for_each(policy, chunk_indexes.begin(), chunk_indexes.end(), [&](size_t chunk_index)
+            {
+                std::copy(chunks[chunk_index].begin(), chunks[chunk_index].end(), result.begin() + offsets[chunk_index]);
+            });
+        for (Bucket& bucket : buckets_)
+        {
+            std::lock_guard guard(bucket.bucket_mutex);
+            result.insert(result.end(), bucket.bucket_map.begin(), bucket.bucket_map.end());
+        }
+        std::sort(policy, result.begin(), result.end(), [](const auto& lhs, const auto& rhs)
+            {
+                return lhs.first < rhs.first;
+            });
         return result;
     }
 
-	void Erase(const Key& key)
-	{
-        auto index = static_cast<uint64_t>(key) % buckets_.size();
+    std::vector<std::pair<Key, Value>> BuildSortedVector() const
+    {
+        return BuildSortedVector(std::execution::par);
+    }
+
+    std::map<Key, Value> BuildOrdinaryMap() const
+    {
+        const auto pairs = BuildSortedVector();
+        return std::map<Key, Value>(pairs.begin(), pairs.end());
+    }
+
+private:
+
+    static size_t RoundUpToPowerOfTwo(size_t value)
+    {
+        size_t result = 1;
+        while (result < value)
         {
-            std::lock_guard guard(buckets_[index].bucket_mutex);
-            buckets_[index].bucket_map.erase(key);
+            result <<= 1;
         }
+        return result;
     }
 
-private:
+    size_t GetStartIndex(const Key& key) const
+    {
+        uint64_t hash = static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(hash ^ (hash >> 32)) & (slots_.size() - 1);
+    }
+
+    Bucket& GetBucket(const Key& key) const
+    {
+        return buckets_[static_cast<uint64_t>(key) % buckets_.size()];
+    }
+
+    // Слот ключа в таблице или nullptr, если ключ хранится в корзине.
+    Slot* FindOrInsert(const Key& key)
+    {
+        size_t index = GetStartIndex(key);
+        for (size_t probe = 0; probe < slots_.size(); ++probe, index = (index + 1) & (slots_.size() - 1))
+        {
+            Slot& slot = slots_[index];
+            uint8_t state = slot.state.load(std::memory_order_acquire);
+            if (state == EMPTY)
+            {
+                if (slot.state.compare_exchange_strong(state, CLAIMED, std::memory_order_acq_rel))
+                {
+                    // Счётчик только растёт: после первого отказа ключи в таблицу больше не попадают.
+                    if (claimed_count_.fetch_add(1, std::memory_order_relaxed) >= table_key_count_)
+                    {
+                        slot.state.store(OVERFLOWED, std::memory_order_release);
+                        return nullptr;
+                    }
+                    slot.key = key;
+                    slot.state.store(READY, std::memory_order_release);
+                    return &slot;
+                }
+            }
+            // Слот занимает другой поток: ключ будет записан через несколько инструкций.
+            while (state == CLAIMED)
+            {
+                std::this_thread::yield();
+                state = slot.state.load(std::memory_order_acquire);
+            }
+            if (state == OVERFLOWED)
+            {
+                return nullptr;
+            }
+            if (slot.key == key)
+            {
+                return &slot;
+            }
+        }
+        return nullptr;
+    }
+
+    // Слот ключа в таблице или nullptr; is_in_bucket сообщает, что ключ может быть в корзине.
+    Slot* Find(const Key& key, bool& is_in_bucket)
+    {
+        size_t index = GetStartIndex(key);
+        for (size_t probe = 0; probe < slots_.size(); ++probe, index = (index + 1) & (slots_.size() - 1))
+        {
+            Slot& slot = slots_[index];
+            uint8_t state = slot.state.load(std::memory_order_acquire);
+            while (state == CLAIMED)
+            {
+                std::this_thread::yield();
+                state = slot.state.load(std::memory_order_acquire);
+            }
+            if (state == EMPTY)
+            {
+                return nullptr;
+            }
+            if (state == OVERFLOWED)
+            {
+                break;
+            }
+            if (slot.key == key)
+            {
+                return &slot;
+            }
+        }
+        is_in_bucket = true;
+        return nullptr;
+    }
 
-    std::vector<Bucket> buckets_;
-};
\ No newline at end of file
+    std::vector<Slot> slots_;
+    size_t table_key_count_;
+    std::atomic<size_t> claimed_count_{ 0 };
+    mutable std::vector<Bucket> buckets_;
+};
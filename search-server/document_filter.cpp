@@ -0,0 +1,119 @@
+#include "document_filter.h"
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SEARCH_SERVER_USE_SSE2
+#endif
+
+namespace
+{
+	// Статусы от ACTUAL до REMOVED.
+	const int DOCUMENT_STATUS_COUNT = 4;
+	const uint32_t KNOWN_STATUSES = (1u << DOCUMENT_STATUS_COUNT) - 1;
+
+	static_assert(sizeof(DocumentStatus) == sizeof(int32_t), "statuses are compared as 32-bit integers");
+}
+
+DocumentFilter DocumentFilter::StatusIn(std::initializer_list<DocumentStatus> statuses) const
+{
+	uint32_t status_mask = 0;
+	for (const DocumentStatus status : statuses)
+	{
+		status_mask |= 1u << static_cast<int>(status);
+	}
+	DocumentFilter filter = *this;
+	filter.status_mask_ &= status_mask;
+	return filter;
+}
+
+DocumentFilter DocumentFilter::RatingBetween(int min_rating, int max_rating) const
+{
+	DocumentFilter filter = *this;
+	filter.min_rating_ = std::max(min_rating_, min_rating);
+	filter.max_rating_ = std::min(max_rating_, max_rating);
+	return filter;
+}
+
+DocumentFilter DocumentFilter::IdModulo(int divisor, int remainder) const
+{
+	if (divisor <= 0 || remainder < 0 || remainder >= divisor)
+	{
+		throw std::invalid_argument("Invalid id divisor or remainder");
+	}
+	if (id_divisor_ != 1)
+	{
+		throw std::invalid_argument("Id modulo condition is already set");
+	}
+	DocumentFilter filter = *this;
+	filter.id_divisor_ = divisor;
+	filter.id_remainder_ = remainder;
+	return filter;
+}
+
+void DocumentFilter::Evaluate(const int* ids, const DocumentStatus* statuses, const int* ratings, size_t count,
+	std::vector<uint64_t>& bits) const
+{
+	bits.assign((count + 63) / 64, 0);
+	size_t i = 0;
+
+#ifdef SEARCH_SERVER_USE_SSE2
+	const bool check_status = (status_mask_ & KNOWN_STATUSES) != KNOWN_STATUSES;
+	const bool check_rating = min_rating_ != std::numeric_limits<int>::min() || max_rating_ != std::numeric_limits<int>::max();
+	__m128i allowed_statuses[DOCUMENT_STATUS_COUNT];
+	int allowed_status_count = 0;
+	for (int status = 0; status < DOCUMENT_STATUS_COUNT; ++status)
+	{
+		if ((status_mask_ >> status) & 1)
+		{
+			allowed_statuses[allowed_status_count++] = _mm_set1_epi32(status);
+		}
+	}
+	const __m128i min_rating = _mm_set1_epi32(min_rating_);
+	const __m128i max_rating = _mm_set1_epi32(max_rating_);
+
+	// Четыре документа за шаг; 64 делится на 4, поэтому маска не пересекает слово карты.
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i passed = _mm_set1_epi32(-1);
+		if (check_status)
+		{
+			const __m128i status = _mm_loadu_si128(reinterpret_cast<const __m128i*>(statuses + i));
+			passed = _mm_setzero_si128();
+			for (int j = 0; j < allowed_status_count; ++j)
+			{
+				passed = _mm_or_si128(passed, _mm_cmpeq_epi32(status, allowed_statuses[j]));
+			}
+		}
+		if (check_rating)
+		{
+			const __m128i rating = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ratings + i));
+			const __m128i outside = _mm_or_si128(_mm_cmplt_epi32(rating, min_rating), _mm_cmpgt_epi32(rating, max_rating));
+			passed = _mm_andnot_si128(outside, passed);
+		}
+		const uint64_t mask = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(passed)));
+		bits[i / 64] |= mask << (i % 64);
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		if (PassesStatusAndRating(statuses[i], ratings[i]))
+		{
+			bits[i / 64] |= uint64_t(1) << (i % 64);
+		}
+	}
+
+	// Целочисленного деления в SSE2 нет, поэтому условие на id проверяется отдельным проходом.
+	if (id_divisor_ != 1)
+	{
+		for (size_t j = 0; j < count; ++j)
+		{
+			if (ids[j] % id_divisor_ != id_remainder_)
+			{
+				bits[j / 64] &= ~(uint64_t(1) << (j % 64));
+			}
+		}
+	}
+}
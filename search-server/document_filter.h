@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <initializer_list>
+#include <limits>
+#include <vector>
+
+#include "document.h"
+
+// Декларативный фильтр документов: условия на статус, рейтинг и остаток от деления id
+// объединяются по «и». Пустой фильтр пропускает все документы.
+//
+// Фильтр можно передать в FindTopDocuments вместо предиката. В отличие от
+// произвольной функции, он вычисляется сразу для всех документов по столбцам
+// атрибутов в битовую карту, а поиск лишь проверяет бит документа.
+class DocumentFilter
+{
+public:
+
+	DocumentFilter StatusIn(std::initializer_list<DocumentStatus> statuses) const;
+
+	DocumentFilter RatingBetween(int min_rating, int max_rating) const;
+
+	DocumentFilter IdModulo(int divisor, int remainder) const;
+
+	bool operator()(int document_id, DocumentStatus status, int rating) const
+	{
+		return PassesStatusAndRating(status, rating)
+			&& (id_divisor_ == 1 || document_id % id_divisor_ == id_remainder_);
+	}
+
+	// Заполняет bits по биту на документ: бит i установлен, если документ с атрибутами
+	// ids[i], statuses[i], ratings[i] проходит фильтр. На x86 по 4 документа за раз.
+	void Evaluate(const int* ids, const DocumentStatus* statuses, const int* ratings, size_t count,
+		std::vector<uint64_t>& bits) const;
+
+private:
+
+	static constexpr uint32_t ALL_STATUSES = ~0u;
+
+	bool PassesStatusAndRating(DocumentStatus status, int rating) const
+	{
+		return ((status_mask_ >> static_cast<int>(status)) & 1) != 0 && rating >= min_rating_ && rating <= max_rating_;
+	}
+
+	uint32_t status_mask_ = ALL_STATUSES;
+	int min_rating_ = std::numeric_limits<int>::min();
+	int max_rating_ = std::numeric_limits<int>::max();
+	int id_divisor_ = 1;
+	int id_remainder_ = 0;
+};
@@ -0,0 +1,384 @@
+#include "index_file.h"
+#include "document.h"
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const uint64_t INDEX_FILE_ALIGNMENT = 8;
+
+	uint64_t AlignUp(uint64_t offset)
+	{
+		return (offset + INDEX_FILE_ALIGNMENT - 1) / INDEX_FILE_ALIGNMENT * INDEX_FILE_ALIGNMENT;
+	}
+
+	uint64_t GetStringTableSize(uint64_t count, uint64_t bytes)
+	{
+		return (count + 1) * sizeof(uint64_t) + bytes;
+	}
+}
+
+void ComputeIndexFileLayout(IndexFileHeader& header, uint64_t stop_words_bytes, uint64_t words_bytes)
+{
+	std::memcpy(header.magic, INDEX_FILE_MAGIC, sizeof(header.magic));
+	header.version = INDEX_FILE_VERSION;
+	header.byte_order = INDEX_FILE_BYTE_ORDER;
+
+	uint64_t offset = AlignUp(sizeof(IndexFileHeader));
+	const auto place = [&offset](uint64_t& section_offset, uint64_t size)
+		{
+			section_offset = offset;
+			offset = AlignUp(offset + size);
+		};
+	place(header.stop_words_offset, GetStringTableSize(header.stop_word_count, stop_words_bytes));
+	place(header.words_offset, GetStringTableSize(header.word_count, words_bytes));
+	place(header.terms_offset, header.word_count * sizeof(IndexTermRecord));
+	place(header.documents_offset, header.document_count * sizeof(IndexDocumentRecord));
+	place(header.free_ordinals_offset, header.free_ordinal_count * sizeof(int32_t));
+	place(header.forward_offsets_offset, (header.document_count + 1) * sizeof(uint64_t));
+	place(header.forward_entries_offset, header.forward_entry_count * sizeof(IndexForwardEntry));
+	place(header.postings_offset, header.posting_count * sizeof(Posting));
+	header.file_size = offset;
+}
+
+void WriteIndexStringTable(std::ostream& output, const std::vector<std::string_view>& strings)
+{
+	uint64_t offset = 0;
+	WriteIndexRecords(output, &offset, 1);
+	for (const std::string_view str : strings)
+	{
+		offset += str.size();
+		WriteIndexRecords(output, &offset, 1);
+	}
+	for (const std::string_view str : strings)
+	{
+		output.write(str.data(), static_cast<std::streamsize>(str.size()));
+	}
+	WriteIndexPadding(output);
+}
+
+void WriteIndexPadding(std::ostream& output)
+{
+	static const char zeros[INDEX_FILE_ALIGNMENT] = {};
+	const uint64_t position = static_cast<uint64_t>(output.tellp());
+	output.write(zeros, static_cast<std::streamsize>(AlignUp(position) - position));
+}
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path)
+{
+	file_handle_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file_handle_ == INVALID_HANDLE_VALUE)
+	{
+		file_handle_ = nullptr;
+		throw std::runtime_error("cannot open index file " + path);
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file_handle_, &file_size) || file_size.QuadPart == 0)
+	{
+		CloseHandle(file_handle_);
+		throw std::runtime_error("cannot map index file " + path);
+	}
+	mapping_handle_ = CreateFileMappingA(file_handle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	const void* view = mapping_handle_ != nullptr ? MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (view == nullptr)
+	{
+		if (mapping_handle_ != nullptr)
+		{
+			CloseHandle(mapping_handle_);
+		}
+		CloseHandle(file_handle_);
+		throw std::runtime_error("cannot map index file " + path);
+	}
+	data_ = static_cast<const char*>(view);
+	size_ = static_cast<size_t>(file_size.QuadPart);
+}
+
+MappedFile::~MappedFile()
+{
+	UnmapViewOfFile(data_);
+	CloseHandle(mapping_handle_);
+	CloseHandle(file_handle_);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path)
+{
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		throw std::runtime_error("cannot open index file " + path);
+	}
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0)
+	{
+		close(fd);
+		throw std::runtime_error("cannot map index file " + path);
+	}
+	size_ = static_cast<size_t>(file_stat.st_size);
+	void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+	{
+		throw std::runtime_error("cannot map index file " + path);
+	}
+	data_ = static_cast<const char*>(data);
+}
+
+MappedFile::~MappedFile()
+{
+	munmap(const_cast<char*>(data_), size_);
+}
+
+#endif
+
+const char* MappedFile::data() const
+{
+	return data_;
+}
+
+size_t MappedFile::size() const
+{
+	return size_;
+}
+
+MappedIndex::MappedIndex(const std::string& path)
+	: file_(path)
+{
+	if (file_.size() < sizeof(IndexFileHeader))
+	{
+		throw std::runtime_error("index file is truncated");
+	}
+	header_ = reinterpret_cast<const IndexFileHeader*>(file_.data());
+	if (std::memcmp(header_->magic, INDEX_FILE_MAGIC, sizeof(INDEX_FILE_MAGIC)) != 0)
+	{
+		throw std::runtime_error("not an index file");
+	}
+	if (header_->byte_order != INDEX_FILE_BYTE_ORDER)
+	{
+		throw std::runtime_error("index file has a different byte order");
+	}
+	if (header_->version != INDEX_FILE_VERSION)
+	{
+		throw std::runtime_error("unsupported index file version");
+	}
+	if (header_->file_size != file_.size())
+	{
+		throw std::runtime_error("index file is truncated");
+	}
+
+	const IndexFileHeader& header = *header_;
+	for (const uint64_t count : { header.stop_word_count, header.word_count, header.document_count,
+		header.free_ordinal_count, header.forward_entry_count, header.posting_count })
+	{
+		if (count >= file_.size())
+		{
+			throw std::runtime_error("index file has invalid section size");
+		}
+	}
+	CheckStringTable(header.stop_words_offset, header.stop_word_count);
+	CheckStringTable(header.words_offset, header.word_count);
+	CheckSection(header.terms_offset, header.word_count * sizeof(IndexTermRecord));
+	CheckSection(header.documents_offset, header.document_count * sizeof(IndexDocumentRecord));
+	CheckSection(header.free_ordinals_offset, header.free_ordinal_count * sizeof(int32_t));
+	CheckSection(header.forward_offsets_offset, (header.document_count + 1) * sizeof(uint64_t));
+	CheckSection(header.forward_entries_offset, header.forward_entry_count * sizeof(IndexForwardEntry));
+	CheckSection(header.postings_offset, header.posting_count * sizeof(Posting));
+
+	for (size_t word_id = 0; word_id < header.word_count; ++word_id)
+	{
+		const IndexTermRecord& term = GetTerm(word_id);
+		if (term.first_posting > header.posting_count || term.posting_count > header.posting_count - term.first_posting)
+		{
+			throw std::runtime_error("index file has invalid postings");
+		}
+	}
+	const uint64_t* forward_offsets = reinterpret_cast<const uint64_t*>(file_.data() + header.forward_offsets_offset);
+	for (size_t ordinal = 0; ordinal < header.document_count; ++ordinal)
+	{
+		if (forward_offsets[ordinal] > forward_offsets[ordinal + 1])
+		{
+			throw std::runtime_error("index file has invalid forward index");
+		}
+	}
+	if (forward_offsets[header.document_count] != header.forward_entry_count)
+	{
+		throw std::runtime_error("index file has invalid forward index");
+	}
+	CheckDocuments();
+	CheckPostings();
+	CheckForwardIndex();
+
+	forward_cache_.resize(header.document_count);
+}
+
+const IndexFileHeader& MappedIndex::GetHeader() const
+{
+	return *header_;
+}
+
+std::string_view MappedIndex::GetStopWord(size_t index) const
+{
+	return GetString(header_->stop_words_offset, header_->stop_word_count, index);
+}
+
+std::string_view MappedIndex::GetWord(size_t word_id) const
+{
+	return GetString(header_->words_offset, header_->word_count, word_id);
+}
+
+const IndexTermRecord& MappedIndex::GetTerm(size_t word_id) const
+{
+	return reinterpret_cast<const IndexTermRecord*>(file_.data() + header_->terms_offset)[word_id];
+}
+
+const Posting* MappedIndex::GetPostings(const IndexTermRecord& term) const
+{
+	return reinterpret_cast<const Posting*>(file_.data() + header_->postings_offset) + term.first_posting;
+}
+
+const IndexDocumentRecord& MappedIndex::GetDocument(size_t ordinal) const
+{
+	return reinterpret_cast<const IndexDocumentRecord*>(file_.data() + header_->documents_offset)[ordinal];
+}
+
+const int32_t* MappedIndex::GetFreeOrdinals() const
+{
+	return reinterpret_cast<const int32_t*>(file_.data() + header_->free_ordinals_offset);
+}
+
+const IndexForwardEntry* MappedIndex::GetForwardBegin(size_t ordinal) const
+{
+	const uint64_t* forward_offsets = reinterpret_cast<const uint64_t*>(file_.data() + header_->forward_offsets_offset);
+	return reinterpret_cast<const IndexForwardEntry*>(file_.data() + header_->forward_entries_offset) + forward_offsets[ordinal];
+}
+
+const IndexForwardEntry* MappedIndex::GetForwardEnd(size_t ordinal) const
+{
+	return GetForwardBegin(ordinal + 1);
+}
+
+const std::map<std::string_view, double>& MappedIndex::GetWordFrequencies(size_t ordinal) const
+{
+	std::lock_guard guard(forward_cache_mutex_);
+	auto& word_freqs = forward_cache_[ordinal];
+	if (!word_freqs)
+	{
+		word_freqs = std::make_unique<std::map<std::string_view, double>>();
+		const double inv_word_count = GetDocument(ordinal).inv_word_count;
+		for (auto entry = GetForwardBegin(ordinal); entry != GetForwardEnd(ordinal); ++entry)
+		{
+			word_freqs->emplace_hint(word_freqs->end(), GetWord(entry->word_id), entry->term_count * inv_word_count);
+		}
+	}
+	return *word_freqs;
+}
+
+std::string_view MappedIndex::GetString(uint64_t table_offset, uint64_t count, size_t index) const
+{
+	const uint64_t* offsets = reinterpret_cast<const uint64_t*>(file_.data() + table_offset);
+	const char* chars = reinterpret_cast<const char*>(offsets + count + 1);
+	return std::string_view(chars + offsets[index], offsets[index + 1] - offsets[index]);
+}
+
+void MappedIndex::CheckStringTable(uint64_t table_offset, uint64_t count) const
+{
+	CheckSection(table_offset, (count + 1) * sizeof(uint64_t));
+	const uint64_t* offsets = reinterpret_cast<const uint64_t*>(file_.data() + table_offset);
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		if (offsets[i] > offsets[i + 1])
+		{
+			throw std::runtime_error("index file has invalid string table");
+		}
+	}
+	CheckSection(table_offset + (count + 1) * sizeof(uint64_t), offsets[count]);
+}
+
+void MappedIndex::CheckSection(uint64_t offset, uint64_t size) const
+{
+	if (offset % INDEX_FILE_ALIGNMENT != 0 || offset > file_.size() || size > file_.size() - offset)
+	{
+		throw std::runtime_error("index file section is out of bounds");
+	}
+}
+
+void MappedIndex::CheckDocuments() const
+{
+	uint64_t empty_count = 0;
+	for (size_t ordinal = 0; ordinal < header_->document_count; ++ordinal)
+	{
+		const IndexDocumentRecord& record = GetDocument(ordinal);
+		if (record.status < static_cast<int32_t>(DocumentStatus::ACTUAL) || record.status > static_cast<int32_t>(DocumentStatus::REMOVED))
+		{
+			throw std::runtime_error("index file has invalid document status");
+		}
+		if (record.id < 0)
+		{
+			++empty_count;
+		}
+	}
+	if (empty_count != header_->free_ordinal_count)
+	{
+		throw std::runtime_error("index file has invalid free ordinals");
+	}
+	std::vector<bool> is_listed(header_->document_count, false);
+	const int32_t* free_ordinals = GetFreeOrdinals();
+	for (size_t i = 0; i < header_->free_ordinal_count; ++i)
+	{
+		const int32_t ordinal = free_ordinals[i];
+		if (ordinal < 0 || static_cast<uint64_t>(ordinal) >= header_->document_count || is_listed[ordinal]
+			|| GetDocument(ordinal).id >= 0)
+		{
+			throw std::runtime_error("index file has invalid free ordinals");
+		}
+		is_listed[ordinal] = true;
+	}
+}
+
+void MappedIndex::CheckPostings() const
+{
+	for (size_t word_id = 0; word_id < header_->word_count; ++word_id)
+	{
+		const IndexTermRecord& term = GetTerm(word_id);
+		const Posting* postings = GetPostings(term);
+		for (uint64_t i = 0; i < term.posting_count; ++i)
+		{
+			const Posting& posting = postings[i];
+			if (posting.ordinal < 0 || static_cast<uint64_t>(posting.ordinal) >= header_->document_count
+				|| (i > 0 && posting.ordinal <= postings[i - 1].ordinal)
+				|| posting.term_count <= 0 || GetDocument(posting.ordinal).id < 0)
+			{
+				throw std::runtime_error("index file has invalid postings");
+			}
+		}
+	}
+}
+
+void MappedIndex::CheckForwardIndex() const
+{
+	for (size_t ordinal = 0; ordinal < header_->document_count; ++ordinal)
+	{
+		for (auto entry = GetForwardBegin(ordinal); entry != GetForwardEnd(ordinal); ++entry)
+		{
+			if (entry->word_id >= header_->word_count || (entry != GetForwardBegin(ordinal) && entry->word_id <= (entry - 1)->word_id)
+				|| entry->term_count <= 0)
+			{
+				throw std::runtime_error("index file has invalid forward index");
+			}
+		}
+	}
+}
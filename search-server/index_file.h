@@ -0,0 +1,167 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "posting_list.h"
+
+// Двоичный формат файла индекса. Все секции выровнены по 8 байтам и хранятся
+// в порядке байтов машины, записавшей файл, поэтому массивы читаются прямо из
+// отображённой памяти без разбора.
+//
+// Таблица строк: uint64_t offsets[count + 1] (смещения от начала символов),
+// затем символы всех строк подряд.
+
+const char INDEX_FILE_MAGIC[8] = { 'S', 'R', 'C', 'H', 'I', 'D', 'X', '\0' };
+const uint32_t INDEX_FILE_VERSION = 1;
+const uint32_t INDEX_FILE_BYTE_ORDER = 0x01020304;
+
+struct IndexFileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+
+	uint64_t stop_word_count;
+	uint64_t word_count;
+	uint64_t document_count;
+	uint64_t free_ordinal_count;
+	uint64_t forward_entry_count;
+	uint64_t posting_count;
+
+	uint64_t stop_words_offset;
+	uint64_t words_offset;
+	uint64_t terms_offset;
+	uint64_t documents_offset;
+	uint64_t free_ordinals_offset;
+	uint64_t forward_offsets_offset;
+	uint64_t forward_entries_offset;
+	uint64_t postings_offset;
+	uint64_t file_size;
+};
+
+// Список вхождений слова с тем же номером в таблице слов.
+struct IndexTermRecord
+{
+	uint64_t first_posting;
+	uint64_t posting_count;
+	double max_term_freq;
+};
+
+// Документ по порядковому номеру. У свободных номеров id равен -1.
+struct IndexDocumentRecord
+{
+	int32_t id;
+	int32_t rating;
+	int32_t status;
+	int32_t reserved;
+	double inv_word_count;
+};
+
+// Слово документа в прямом индексе. Слова документа упорядочены по номеру,
+// а таблица слов отсортирована, поэтому порядок совпадает с порядком строк.
+struct IndexForwardEntry
+{
+	uint32_t word_id;
+	int32_t term_count;
+};
+
+// Заполняет смещения секций по числу элементов и размерам таблиц строк.
+void ComputeIndexFileLayout(IndexFileHeader& header, uint64_t stop_words_bytes, uint64_t words_bytes);
+
+void WriteIndexStringTable(std::ostream& output, const std::vector<std::string_view>& strings);
+
+void WriteIndexPadding(std::ostream& output);
+
+template <typename Record>
+void WriteIndexRecords(std::ostream& output, const Record* records, size_t count)
+{
+	output.write(reinterpret_cast<const char*>(records), static_cast<std::streamsize>(count * sizeof(Record)));
+}
+
+// Файл, отображённый в память только для чтения.
+class MappedFile
+{
+public:
+
+	explicit MappedFile(const std::string& path);
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile();
+
+	const char* data() const;
+
+	size_t size() const;
+
+private:
+
+	const char* data_ = nullptr;
+	size_t size_ = 0;
+#ifdef _WIN32
+	void* file_handle_ = nullptr;
+	void* mapping_handle_ = nullptr;
+#endif
+};
+
+// Открытый файл индекса. Проверяет заголовок, границы секций и их содержимое и
+// выдаёт указатели на данные внутри отображения. Номера документов и слов из файла
+// дальше используются как индексы массивов без проверок, поэтому при открытии
+// файл читается целиком: время открытия линейно по его размеру.
+class MappedIndex
+{
+public:
+
+	explicit MappedIndex(const std::string& path);
+
+	const IndexFileHeader& GetHeader() const;
+
+	std::string_view GetStopWord(size_t index) const;
+
+	std::string_view GetWord(size_t word_id) const;
+
+	const IndexTermRecord& GetTerm(size_t word_id) const;
+
+	const Posting* GetPostings(const IndexTermRecord& term) const;
+
+	const IndexDocumentRecord& GetDocument(size_t ordinal) const;
+
+	const int32_t* GetFreeOrdinals() const;
+
+	const IndexForwardEntry* GetForwardBegin(size_t ordinal) const;
+
+	const IndexForwardEntry* GetForwardEnd(size_t ordinal) const;
+
+	// Прямой индекс документа в виде словаря. Строится при первом обращении
+	// и кешируется; ключи указывают на строки внутри отображения.
+	const std::map<std::string_view, double>& GetWordFrequencies(size_t ordinal) const;
+
+private:
+
+	std::string_view GetString(uint64_t table_offset, uint64_t count, size_t index) const;
+
+	void CheckStringTable(uint64_t table_offset, uint64_t count) const;
+
+	void CheckSection(uint64_t offset, uint64_t size) const;
+
+	// Статусы документов и свободные номера: каждый номер без документа указан ровно один раз.
+	void CheckDocuments() const;
+
+	// Номера документов в списке вхождений возрастают и указывают на документы.
+	void CheckPostings() const;
+
+	// Номера слов документа возрастают и меньше числа слов.
+	void CheckForwardIndex() const;
+
+	MappedFile file_;
+	const IndexFileHeader* header_ = nullptr;
+	mutable std::mutex forward_cache_mutex_;
+	mutable std::vector<std::unique_ptr<std::map<std::string_view, double>>> forward_cache_;
+};
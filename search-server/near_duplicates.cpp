@@ -0,0 +1,281 @@
+#include "near_duplicates.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <execution>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace
+{
+	// Пары из корзин не крупнее этой проверяются все и потом, параллельно по парам.
+	// В крупной корзине, например из коротких текстов или общей шаблонной полосы,
+	// документ сравнивается с представителем каждой уже найденной в ней группы.
+	const size_t MAX_ALL_PAIRS_BUCKET_SIZE = 16;
+
+	uint64_t MixBits(uint64_t value)
+	{
+		value ^= value >> 30;
+		value *= 0xbf58476d1ce4e5b9ULL;
+		value ^= value >> 27;
+		value *= 0x94d049bb133111ebULL;
+		value ^= value >> 31;
+		return value;
+	}
+
+	// Подпись: для каждой из hash_count функций h_k(x) = h1(x) + k * h2(x)
+	// минимум по словам документа. У пустого набора слов подпись из максимумов.
+	void ComputeSignature(const std::vector<int>& word_ids, uint64_t* signature, size_t hash_count)
+	{
+		std::fill(signature, signature + hash_count, std::numeric_limits<uint64_t>::max());
+		for (const int word_id : word_ids)
+		{
+			const uint64_t value = static_cast<uint32_t>(word_id);
+			const uint64_t first_hash = MixBits(value);
+			const uint64_t second_hash = MixBits(value ^ 0x9e3779b97f4a7c15ULL) | 1;
+			uint64_t hash = first_hash;
+			for (size_t k = 0; k < hash_count; ++k, hash += second_hash)
+			{
+				signature[k] = std::min(signature[k], hash);
+			}
+		}
+	}
+
+	// Порог полос (1 / bands) ^ (1 / rows) — похожесть, при которой пара становится
+	// кандидатом с вероятностью около половины. Выбирается наибольший порог не выше
+	// min_similarity - 0.1, чтобы пары у самого порога находились почти всегда.
+	size_t ChooseRowsPerBand(size_t hash_count, double min_similarity)
+	{
+		size_t best_rows = 1;
+		for (size_t rows = 1; rows <= hash_count; ++rows)
+		{
+			const double band_count = static_cast<double>(hash_count / rows);
+			if (std::pow(1.0 / band_count, 1.0 / rows) <= min_similarity - 0.1)
+			{
+				best_rows = rows;
+			}
+		}
+		return best_rows;
+	}
+
+	double ComputeJaccardSimilarity(const std::vector<int>& lhs, const std::vector<int>& rhs)
+	{
+		if (lhs.empty() && rhs.empty())
+		{
+			return 1.0;
+		}
+		size_t common_count = 0;
+		for (auto left = lhs.begin(), right = rhs.begin(); left != lhs.end() && right != rhs.end();)
+		{
+			if (*left < *right)
+			{
+				++left;
+			}
+			else if (*right < *left)
+			{
+				++right;
+			}
+			else
+			{
+				++common_count;
+				++left;
+				++right;
+			}
+		}
+		return static_cast<double>(common_count) / static_cast<double>(lhs.size() + rhs.size() - common_count);
+	}
+
+	size_t FindRoot(std::vector<size_t>& parents, size_t index)
+	{
+		while (parents[index] != index)
+		{
+			parents[index] = parents[parents[index]];
+			index = parents[index];
+		}
+		return index;
+	}
+
+	void Unite(std::vector<size_t>& parents, size_t first, size_t second)
+	{
+		// Корнем остаётся меньший индекс, то есть меньший id.
+		const size_t first_root = FindRoot(parents, first);
+		const size_t second_root = FindRoot(parents, second);
+		parents[std::max(first_root, second_root)] = std::min(first_root, second_root);
+	}
+
+	// Группы крупной корзины собираются по ходу: документ сравнивается с представителем
+	// каждой найденной группы и присоединяется ко всем, с которыми похож; если таких нет,
+	// он начинает новую группу. Найденные пары записываются в similar_pairs.
+	void FindSimilarPairsInBucket(const SearchServer& search_server, const std::vector<int>& document_ids,
+		const std::vector<size_t>& bucket, double min_similarity, std::vector<std::pair<size_t, size_t>>& similar_pairs)
+	{
+		std::vector<size_t> representatives;
+		std::vector<std::vector<int>> representative_word_ids;
+		std::vector<int> word_ids;
+		for (const size_t index : bucket)
+		{
+			search_server.GetDocumentWordIds(document_ids[index], word_ids);
+			size_t own_group = representatives.size();
+			for (size_t group = 0; group < representatives.size();)
+			{
+				if (ComputeJaccardSimilarity(word_ids, representative_word_ids[group]) < min_similarity)
+				{
+					++group;
+					continue;
+				}
+				similar_pairs.push_back({ representatives[group], index });
+				if (own_group == representatives.size())
+				{
+					own_group = group++;
+					continue;
+				}
+				// Документ связал две группы: дальше у них один представитель.
+				representatives.erase(representatives.begin() + group);
+				representative_word_ids.erase(representative_word_ids.begin() + group);
+			}
+			if (own_group == representatives.size())
+			{
+				representatives.push_back(index);
+				representative_word_ids.push_back(word_ids);
+			}
+		}
+	}
+}
+
+std::vector<std::vector<int>> FindNearDuplicates(const SearchServer& search_server, const NearDuplicateOptions& options)
+{
+	if (options.hash_count == 0 || !(options.min_similarity > 0.0 && options.min_similarity <= 1.0))
+	{
+		throw std::invalid_argument("Invalid near-duplicate options");
+	}
+	const std::vector<int> document_ids(search_server.begin(), search_server.end());
+	const size_t document_count = document_ids.size();
+	const size_t hash_count = options.hash_count;
+
+	std::vector<size_t> indexes(document_count);
+	std::iota(indexes.begin(), indexes.end(), 0);
+	std::vector<uint64_t> signatures(document_count * hash_count);
+	std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t index)
+		{
+			thread_local std::vector<int> word_ids;
+			search_server.GetDocumentWordIds(document_ids[index], word_ids);
+			ComputeSignature(word_ids, &signatures[index * hash_count], hash_count);
+		});
+
+	// Каждая полоса раскладывает документы по корзинам независимо от других.
+	const size_t rows = ChooseRowsPerBand(hash_count, options.min_similarity);
+	std::vector<std::vector<std::pair<size_t, size_t>>> band_candidates(hash_count / rows);
+	std::vector<std::vector<std::pair<size_t, size_t>>> band_similar_pairs(band_candidates.size());
+	std::vector<size_t> bands(band_candidates.size());
+	std::iota(bands.begin(), bands.end(), 0);
+	std::for_each(std::execution::par, bands.begin(), bands.end(), [&](size_t band)
+		{
+			std::unordered_map<uint64_t, std::vector<size_t>> buckets;
+			for (size_t index = 0; index < document_count; ++index)
+			{
+				const uint64_t* row = &signatures[index * hash_count + band * rows];
+				uint64_t band_hash = band;
+				for (size_t i = 0; i < rows; ++i)
+				{
+					band_hash = MixBits(band_hash ^ row[i]);
+				}
+				buckets[band_hash].push_back(index);
+			}
+
+			auto& candidates = band_candidates[band];
+			for (const auto& [_, bucket] : buckets)
+			{
+				if (bucket.size() <= MAX_ALL_PAIRS_BUCKET_SIZE)
+				{
+					for (size_t i = 0; i < bucket.size(); ++i)
+					{
+						for (size_t j = i + 1; j < bucket.size(); ++j)
+						{
+							candidates.push_back({ bucket[i], bucket[j] });
+						}
+					}
+					continue;
+				}
+				FindSimilarPairsInBucket(search_server, document_ids, bucket, options.min_similarity, band_similar_pairs[band]);
+			}
+		});
+
+	std::vector<std::pair<size_t, size_t>> candidates;
+	for (auto& band : band_candidates)
+	{
+		candidates.insert(candidates.end(), band.begin(), band.end());
+		band.clear();
+		band.shrink_to_fit();
+	}
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+	// Кандидаты проверяются точно по наборам слов.
+	std::vector<char> is_similar(candidates.size());
+	std::transform(std::execution::par, candidates.begin(), candidates.end(), is_similar.begin(),
+		[&](const std::pair<size_t, size_t>& candidate)
+		{
+			thread_local std::vector<int> lhs;
+			thread_local std::vector<int> rhs;
+			search_server.GetDocumentWordIds(document_ids[candidate.first], lhs);
+			search_server.GetDocumentWordIds(document_ids[candidate.second], rhs);
+			return ComputeJaccardSimilarity(lhs, rhs) >= options.min_similarity;
+		});
+
+	std::vector<size_t> parents(document_count);
+	std::iota(parents.begin(), parents.end(), 0);
+	for (size_t i = 0; i < candidates.size(); ++i)
+	{
+		if (is_similar[i])
+		{
+			Unite(parents, candidates[i].first, candidates[i].second);
+		}
+	}
+	for (const auto& similar_pairs : band_similar_pairs)
+	{
+		for (const auto& [first, second] : similar_pairs)
+		{
+			Unite(parents, first, second);
+		}
+	}
+
+	std::vector<std::vector<int>> groups;
+	std::vector<size_t> group_indexes(document_count, std::numeric_limits<size_t>::max());
+	for (size_t index = 0; index < document_count; ++index)
+	{
+		const size_t root = FindRoot(parents, index);
+		if (root == index)
+		{
+			continue;
+		}
+		if (group_indexes[root] == std::numeric_limits<size_t>::max())
+		{
+			group_indexes[root] = groups.size();
+			groups.push_back({ document_ids[root] });
+		}
+		groups[group_indexes[root]].push_back(document_ids[index]);
+	}
+	std::sort(groups.begin(), groups.end());
+	return groups;
+}
+
+void RemoveNearDuplicates(SearchServer& search_server, const NearDuplicateOptions& options)
+{
+	std::vector<int> documents_to_remove;
+	for (const auto& group : FindNearDuplicates(search_server, options))
+	{
+		documents_to_remove.insert(documents_to_remove.end(), group.begin() + 1, group.end());
+	}
+	std::sort(documents_to_remove.begin(), documents_to_remove.end());
+
+	for (const int document_id : documents_to_remove)
+	{
+		std::cout << "Found near-duplicate document id " << document_id << std::endl;
+	}
+	search_server.RemoveDocuments(documents_to_remove);
+}
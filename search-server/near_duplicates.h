@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include "search_server.h"
+
+// Поиск почти одинаковых документов: наборы слов сравниваются по мере Жаккара
+// |A ∩ B| / |A ∪ B|.
+//
+// Для каждого документа параллельно строится MinHash-подпись из hash_count
+// минимумов хешей его слов. Подписи делятся на полосы (LSH): документы, у
+// которых совпала хотя бы одна полоса, становятся кандидатами, и только для них
+// мера Жаккара считается точно. Число полос подбирается по порогу так, чтобы
+// пары с похожестью не ниже порога почти наверняка попадали в кандидаты.
+struct NearDuplicateOptions
+{
+	double min_similarity = 0.8;
+	// Подписи всех документов занимают N * hash_count * 8 байт, при 128 хешах — 1 КиБ на документ.
+	size_t hash_count = 128;
+};
+
+// Группы почти одинаковых документов по возрастанию id, группы упорядочены по
+// первому id. Группа — связная компонента пар с похожестью не ниже порога,
+// поэтому крайние документы длинной цепочки могут различаться сильнее.
+std::vector<std::vector<int>> FindNearDuplicates(const SearchServer& search_server,
+	const NearDuplicateOptions& options = {});
+
+// Удаляет почти дубликаты, оставляя в каждой группе документ с наименьшим id,
+// и сообщает о каждом удалённом документе.
+void RemoveNearDuplicates(SearchServer& search_server, const NearDuplicateOptions& options = {});
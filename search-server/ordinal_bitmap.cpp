@@ -0,0 +1,21 @@
+#include "ordinal_bitmap.h"
+
+void OrdinalBitmap::Reset(size_t ordinal_count)
+{
+	for (const int word_index : touched_)
+	{
+		words_[word_index] = 0;
+	}
+	touched_.clear();
+
+	const size_t word_count = (ordinal_count + 63) / 64;
+	if (words_.size() < word_count)
+	{
+		words_.resize(word_count, 0);
+	}
+}
+
+bool OrdinalBitmap::empty() const
+{
+	return touched_.empty();
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Плотное множество порядковых номеров документов: по биту на номер.
+// Как и RelevanceAccumulator, запоминает затронутые слова битовой карты,
+// поэтому очистка стоит O(числа отмеченных слов), а память переиспользуется.
+class OrdinalBitmap
+{
+public:
+
+	void Reset(size_t ordinal_count);
+
+	void Insert(int ordinal)
+	{
+		uint64_t& word = words_[ordinal >> 6];
+		if (word == 0)
+		{
+			touched_.push_back(ordinal >> 6);
+		}
+		word |= uint64_t(1) << (ordinal & 63);
+	}
+
+	bool Contains(int ordinal) const
+	{
+		return (words_[ordinal >> 6] >> (ordinal & 63)) & 1;
+	}
+
+	bool empty() const;
+
+private:
+
+	std::vector<uint64_t> words_;
+	std::vector<int> touched_;
+};
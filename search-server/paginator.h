@@ -1,6 +1,15 @@
 #pragma once
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 #include <vector>
 
+#include "document.h"
+
 template <typename RandomIt>
 class IteratorRange
 {
@@ -52,58 +61,224 @@ std::ostream& operator<<(std::ostream& os, const IteratorRange<RandomIt>& iter_r
 	return os;
 }
 
+// Разбивает диапазон на страницы по page_size элементов. Страницы не хранятся:
+// итератор вычисляет границы очередной страницы при переходе к ней и держит её
+// у себя, поэтому ссылка на страницу действительна до сдвига итератора.
 template <typename Iter>
 class Paginator
 {
 public:
 
-	Paginator(Iter range_begin, Iter range_end, size_t page_size)
+	class PageIterator
 	{
-		int num_pages = (range_end - range_begin) / page_size;
-		if ((range_end - range_begin) % page_size != 0)
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = IteratorRange<Iter>;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const IteratorRange<Iter>*;
+		using reference = const IteratorRange<Iter>&;
+
+		PageIterator(Iter page_begin, Iter range_end, size_t page_size)
+			: page_(page_begin, GetPageEnd(page_begin, range_end, page_size))
+			, range_end_(range_end)
+			, page_size_(page_size)
+		{}
+
+		reference operator*() const
 		{
-			++num_pages;
+			return page_;
 		}
-		for (int i = 0; i < num_pages; ++i)
+
+		pointer operator->() const
 		{
-			auto fst_record = next(range_begin, page_size * i);
-			auto lst_record = next(fst_record, std::min(page_size, static_cast<size_t>(range_end - fst_record)));
-			pages_.push_back({ fst_record, lst_record });
+			return &page_;
 		}
-	}
 
-	auto begin()
-	{
-		return pages_.begin();
-	}
+		PageIterator& operator++()
+		{
+			page_ = { page_.end(), GetPageEnd(page_.end(), range_end_, page_size_) };
+			return *this;
+		}
+
+		PageIterator operator++(int)
+		{
+			PageIterator result = *this;
+			++*this;
+			return result;
+		}
+
+		bool operator==(const PageIterator& other) const
+		{
+			return page_.begin() == other.page_.begin();
+		}
+
+		bool operator!=(const PageIterator& other) const
+		{
+			return !(*this == other);
+		}
+
+	private:
 
-	auto end()
+		static Iter GetPageEnd(Iter page_begin, Iter range_end, size_t page_size)
+		{
+			return std::next(page_begin, std::min(page_size, static_cast<size_t>(std::distance(page_begin, range_end))));
+		}
+
+		IteratorRange<Iter> page_;
+		Iter range_end_;
+		size_t page_size_;
+	};
+
+	Paginator(Iter range_begin, Iter range_end, size_t page_size)
+		: range_begin_(range_begin)
+		, range_end_(range_end)
+		, page_size_(page_size)
 	{
-		return pages_.end();
+		if (page_size_ == 0)
+		{
+			throw std::invalid_argument("Page size must be positive");
+		}
 	}
 
-	auto begin() const
+	PageIterator begin() const
 	{
-		return pages_.begin();
+		return { range_begin_, range_end_, page_size_ };
 	}
 
-	auto end() const
+	PageIterator end() const
 	{
-		return pages_.end();
+		return { range_end_, range_end_, page_size_ };
 	}
 
 	size_t size() const
 	{
-		return pages_.size();
+		return (static_cast<size_t>(std::distance(range_begin_, range_end_)) + page_size_ - 1) / page_size_;
 	}
 
 private:
 
-	std::vector<IteratorRange<Iter>> pages_;
+	Iter range_begin_;
+	Iter range_end_;
+	size_t page_size_;
 };
 
 template <typename Container>
 auto Paginate(const Container& container, size_t page_size)
 {
 	return Paginator(container.begin(), container.end(), page_size);
-}
\ No newline at end of file
+}
+
+// Ленивая постраничная выдача поиска. Страница ищется при переходе к ней
+// продолжением по курсору (FindTopDocumentsAfter от последнего документа
+// предыдущей страницы), поэтому вся выдача не собирается, а прошлые страницы
+// не хранятся и не ранжируются заново. Обходится один раз; сервер должен
+// жить дольше объекта.
+template <typename SearchServerType, typename Criterion>
+class SearchPaginator
+{
+public:
+
+	class PageIterator
+	{
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = std::vector<Document>;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const std::vector<Document>*;
+		using reference = const std::vector<Document>&;
+
+		PageIterator() = default;
+
+		explicit PageIterator(SearchPaginator* paginator)
+			: paginator_(paginator)
+		{}
+
+		reference operator*() const
+		{
+			return paginator_->page_;
+		}
+
+		pointer operator->() const
+		{
+			return &paginator_->page_;
+		}
+
+		PageIterator& operator++()
+		{
+			paginator_->FetchNextPage();
+			return *this;
+		}
+
+		bool operator==(const PageIterator& other) const
+		{
+			return IsEnd() == other.IsEnd();
+		}
+
+		bool operator!=(const PageIterator& other) const
+		{
+			return !(*this == other);
+		}
+
+	private:
+
+		bool IsEnd() const
+		{
+			return paginator_ == nullptr || paginator_->page_.empty();
+		}
+
+		SearchPaginator* paginator_ = nullptr;
+	};
+
+	SearchPaginator(const SearchServerType& search_server, std::string raw_query, Criterion criterion, size_t page_size)
+		: search_server_(search_server)
+		, raw_query_(std::move(raw_query))
+		, criterion_(criterion)
+		, page_size_(page_size)
+	{}
+
+	SearchPaginator(const SearchPaginator&) = delete;
+	SearchPaginator& operator=(const SearchPaginator&) = delete;
+
+	PageIterator begin()
+	{
+		if (!started_)
+		{
+			started_ = true;
+			// Первая страница — обычный топ, она может прийти из кеша результатов.
+			page_ = search_server_.FindTopDocuments(raw_query_, criterion_, page_size_);
+		}
+		return PageIterator(this);
+	}
+
+	PageIterator end()
+	{
+		return PageIterator();
+	}
+
+private:
+
+	void FetchNextPage()
+	{
+		if (page_.size() < page_size_)
+		{
+			page_.clear();
+			return;
+		}
+		const Document after = page_.back();
+		page_ = search_server_.FindTopDocumentsAfter(raw_query_, criterion_, after, page_size_);
+	}
+
+	const SearchServerType& search_server_;
+	std::string raw_query_;
+	Criterion criterion_;
+	size_t page_size_;
+	bool started_ = false;
+	std::vector<Document> page_;
+};
+
+template <typename SearchServerType, typename Criterion>
+SearchPaginator<SearchServerType, Criterion> PaginateSearch(const SearchServerType& search_server, std::string_view raw_query,
+	Criterion criterion, size_t page_size)
+{
+	return SearchPaginator<SearchServerType, Criterion>(search_server, std::string(raw_query), criterion, page_size);
+}
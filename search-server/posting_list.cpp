@@ -0,0 +1,441 @@
+#include "posting_list.h"
+#include <algorithm>
+
+namespace
+{
+	bool PostingLess(const Posting& posting, int ordinal)
+	{
+		return posting.ordinal < ordinal;
+	}
+
+	void WriteVarint(std::vector<uint8_t>& output, uint32_t value)
+	{
+		while (value >= 0x80)
+		{
+			output.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		output.push_back(static_cast<uint8_t>(value));
+	}
+
+	uint32_t ReadVarint(const uint8_t*& input)
+	{
+		uint32_t value = *input & 0x7F;
+		int shift = 7;
+		while (*input++ & 0x80)
+		{
+			value |= static_cast<uint32_t>(*input & 0x7F) << shift;
+			shift += 7;
+		}
+		return value;
+	}
+}
+
+PostingList::Cursor::Cursor(const PostingList& postings)
+	: postings_(&postings)
+{
+	if (!postings.blocks_.empty())
+	{
+		own_buffer_.reset(new Posting[MAX_BLOCK_SIZE]);
+		buffer_ = own_buffer_.get();
+	}
+	LoadNextBlock();
+}
+
+PostingList::Cursor::Cursor(const PostingList& postings, Posting* buffer)
+	: postings_(&postings)
+	, buffer_(buffer)
+{
+	LoadNextBlock();
+}
+
+void PostingList::Cursor::LoadNextBlock()
+{
+	if (next_block_ < postings_->blocks_.size())
+	{
+		postings_->DecodeBlock(next_block_++, buffer_);
+		current_ = buffer_;
+		position_ = 0;
+		size_ = postings_->blocks_[next_block_ - 1].size;
+	}
+	else if (!in_tail_)
+	{
+		in_tail_ = true;
+		current_ = postings_->GetTailData();
+		position_ = 0;
+		size_ = postings_->GetTailSize();
+	}
+}
+
+void PostingList::Cursor::SeekGE(int ordinal)
+{
+	if (!IsValid() || Get().ordinal >= ordinal)
+	{
+		return;
+	}
+
+	if (!in_tail_ && current_[size_ - 1].ordinal < ordinal)
+	{
+		const auto& blocks = postings_->blocks_;
+		next_block_ = std::partition_point(blocks.begin() + next_block_, blocks.end(), [ordinal](const Block& block)
+			{
+				return block.last_ordinal < ordinal;
+			}) - blocks.begin();
+		LoadNextBlock();
+	}
+	position_ = std::lower_bound(current_ + position_, current_ + size_, ordinal, PostingLess) - current_;
+}
+
+PostingList::PostingList(const Posting* postings, size_t size, double max_term_freq)
+	: borrowed_(postings)
+	, borrowed_size_(size)
+	, max_term_freq_(max_term_freq)
+{}
+
+void PostingList::Add(int ordinal, int term_count, double term_freq)
+{
+	Materialize();
+	max_term_freq_ = std::max(max_term_freq_, term_freq);
+
+	if (!blocks_.empty() && ordinal <= blocks_.back().last_ordinal)
+	{
+		const size_t block_index = FindBlock(ordinal);
+		std::array<Posting, MAX_BLOCK_SIZE + BLOCK_SIZE> postings;
+		size_t count = blocks_[block_index].size;
+		DecodeBlock(block_index, postings.data());
+		Posting* const it = std::lower_bound(postings.data(), postings.data() + count, ordinal, PostingLess);
+		if (it->ordinal == ordinal)
+		{
+			it->term_count += term_count;
+		}
+		else
+		{
+			std::copy_backward(it, postings.data() + count, postings.data() + count + 1);
+			*it = { ordinal, term_count };
+			++count;
+		}
+		ReplaceBlock(block_index, postings.data(), count);
+		return;
+	}
+
+	if (tail_.empty() || tail_.back().ordinal < ordinal)
+	{
+		tail_.push_back({ ordinal, term_count });
+	}
+	else
+	{
+		auto it = std::lower_bound(tail_.begin(), tail_.end(), ordinal, PostingLess);
+		if (it->ordinal == ordinal)
+		{
+			it->term_count += term_count;
+		}
+		else
+		{
+			tail_.insert(it, { ordinal, term_count });
+		}
+	}
+	if (compressed_ && tail_.size() == BLOCK_SIZE)
+	{
+		AppendBlock(tail_.data(), tail_.size());
+		tail_.clear();
+	}
+}
+
+bool PostingList::Erase(int ordinal)
+{
+	if (borrowed_ != nullptr && !Contains(ordinal))
+	{
+		return false;
+	}
+	Materialize();
+	if (!blocks_.empty() && ordinal <= blocks_.back().last_ordinal)
+	{
+		const size_t block_index = FindBlock(ordinal);
+		if (blocks_[block_index].first_ordinal > ordinal)
+		{
+			return false;
+		}
+		std::array<Posting, MAX_BLOCK_SIZE + BLOCK_SIZE> postings;
+		const size_t count = blocks_[block_index].size;
+		DecodeBlock(block_index, postings.data());
+		Posting* const it = std::lower_bound(postings.data(), postings.data() + count, ordinal, PostingLess);
+		if (it->ordinal != ordinal)
+		{
+			return false;
+		}
+		std::copy(it + 1, postings.data() + count, it);
+		ReplaceBlock(block_index, postings.data(), count - 1);
+	}
+	else
+	{
+		auto it = std::lower_bound(tail_.begin(), tail_.end(), ordinal, PostingLess);
+		if (it == tail_.end() || it->ordinal != ordinal)
+		{
+			return false;
+		}
+		tail_.erase(it);
+	}
+
+	if (empty())
+	{
+		max_term_freq_ = 0.0;
+	}
+	return true;
+}
+
+void PostingList::Erase(const std::vector<bool>& removed_ordinals)
+{
+	const auto is_removed = [&removed_ordinals](const Posting& posting)
+		{
+			return static_cast<size_t>(posting.ordinal) < removed_ordinals.size() && removed_ordinals[posting.ordinal];
+		};
+
+	Materialize();
+	tail_.erase(std::remove_if(tail_.begin(), tail_.end(), is_removed), tail_.end());
+	// Блоки обходятся с конца: удалённый или слитый блок не сдвигает ещё не обойдённые.
+	std::array<Posting, MAX_BLOCK_SIZE + BLOCK_SIZE> postings;
+	for (size_t block_index = blocks_.size(); block_index-- > 0;)
+	{
+		const size_t count = blocks_[block_index].size;
+		DecodeBlock(block_index, postings.data());
+		const size_t new_count = std::remove_if(postings.data(), postings.data() + count, is_removed) - postings.data();
+		if (new_count != count)
+		{
+			ReplaceBlock(block_index, postings.data(), new_count);
+		}
+	}
+
+	if (empty())
+	{
+		max_term_freq_ = 0.0;
+	}
+}
+
+bool PostingList::Contains(int ordinal) const
+{
+	if (!blocks_.empty() && ordinal <= blocks_.back().last_ordinal)
+	{
+		const Block& block = blocks_[FindBlock(ordinal)];
+		if (block.first_ordinal > ordinal)
+		{
+			return false;
+		}
+		// Номера читаются до искомого, без распаковки всего блока.
+		const uint8_t* input = data_.data() + block.offset;
+		int current_ordinal = block.first_ordinal;
+		for (size_t i = 0; i < block.size; ++i)
+		{
+			current_ordinal += static_cast<int>(ReadVarint(input));
+			if (current_ordinal >= ordinal)
+			{
+				return current_ordinal == ordinal;
+			}
+			ReadVarint(input);
+		}
+		return false;
+	}
+	const Posting* const tail = GetTailData();
+	const Posting* const tail_end = tail + GetTailSize();
+	const Posting* const it = std::lower_bound(tail, tail_end, ordinal, PostingLess);
+	return it != tail_end && it->ordinal == ordinal;
+}
+
+double PostingList::GetMaxTermFreq() const
+{
+	return max_term_freq_;
+}
+
+void PostingList::SetCompressed(bool compressed)
+{
+	if (compressed_ == compressed)
+	{
+		return;
+	}
+	Materialize();
+	std::vector<Posting> postings = Decompress();
+	compressed_ = compressed;
+	if (compressed_)
+	{
+		Compress(std::move(postings));
+	}
+	else
+	{
+		blocks_.clear();
+		blocks_.shrink_to_fit();
+		data_.clear();
+		data_.shrink_to_fit();
+		garbage_bytes_ = 0;
+		block_postings_count_ = 0;
+		tail_ = std::move(postings);
+	}
+}
+
+bool PostingList::IsCompressed() const
+{
+	return compressed_;
+}
+
+size_t PostingList::GetMemoryUsage() const
+{
+	return sizeof(PostingList)
+		+ blocks_.capacity() * sizeof(Block)
+		+ data_.capacity()
+		+ tail_.capacity() * sizeof(Posting);
+}
+
+size_t PostingList::size() const
+{
+	return block_postings_count_ + GetTailSize();
+}
+
+bool PostingList::empty() const
+{
+	return blocks_.empty() && GetTailSize() == 0;
+}
+
+std::vector<Posting> PostingList::Decompress() const
+{
+	std::vector<Posting> postings(size());
+	Posting* output = postings.data();
+	for (size_t block_index = 0; block_index < blocks_.size(); ++block_index)
+	{
+		DecodeBlock(block_index, output);
+		output += blocks_[block_index].size;
+	}
+	std::copy(GetTailData(), GetTailData() + GetTailSize(), output);
+	return postings;
+}
+
+void PostingList::Compress(std::vector<Posting> postings)
+{
+	blocks_.clear();
+	data_.clear();
+	garbage_bytes_ = 0;
+	block_postings_count_ = 0;
+	const size_t block_count = postings.size() / BLOCK_SIZE;
+	for (size_t block_index = 0; block_index < block_count; ++block_index)
+	{
+		AppendBlock(postings.data() + block_index * BLOCK_SIZE, BLOCK_SIZE);
+	}
+	blocks_.shrink_to_fit();
+	data_.shrink_to_fit();
+	tail_ = std::vector<Posting>(postings.begin() + block_count * BLOCK_SIZE, postings.end());
+}
+
+void PostingList::AppendBlock(const Posting* postings, size_t count)
+{
+	EncodeBlock(postings, count, blocks_.emplace_back());
+	block_postings_count_ += count;
+}
+
+void PostingList::EncodeBlock(const Posting* postings, size_t count, Block& block)
+{
+	block.first_ordinal = postings[0].ordinal;
+	block.last_ordinal = postings[count - 1].ordinal;
+	block.offset = static_cast<uint32_t>(data_.size());
+	block.size = static_cast<uint32_t>(count);
+	int previous_ordinal = postings[0].ordinal;
+	for (size_t i = 0; i < count; ++i)
+	{
+		WriteVarint(data_, static_cast<uint32_t>(postings[i].ordinal - previous_ordinal));
+		WriteVarint(data_, static_cast<uint32_t>(postings[i].term_count));
+		previous_ordinal = postings[i].ordinal;
+	}
+	block.byte_size = static_cast<uint32_t>(data_.size() - block.offset);
+}
+
+void PostingList::DecodeBlock(size_t block_index, Posting* output) const
+{
+	const Block& block = blocks_[block_index];
+	const uint8_t* input = data_.data() + block.offset;
+	int ordinal = block.first_ordinal;
+	for (size_t i = 0; i < block.size; ++i)
+	{
+		ordinal += static_cast<int>(ReadVarint(input));
+		output[i] = { ordinal, static_cast<int>(ReadVarint(input)) };
+	}
+}
+
+size_t PostingList::FindBlock(int ordinal) const
+{
+	return std::partition_point(blocks_.begin(), blocks_.end(), [ordinal](const Block& block)
+		{
+			return block.last_ordinal < ordinal;
+		}) - blocks_.begin();
+}
+
+void PostingList::ReplaceBlock(size_t block_index, Posting* postings, size_t count)
+{
+	garbage_bytes_ += blocks_[block_index].byte_size;
+	block_postings_count_ -= blocks_[block_index].size;
+
+	// Почти пустой блок забирает вхождения следующего, чтобы блоки не мельчали.
+	if (count < BLOCK_SIZE / 4 && block_index + 1 < blocks_.size())
+	{
+		const Block& next_block = blocks_[block_index + 1];
+		std::copy_backward(postings, postings + count, postings + next_block.size + count);
+		DecodeBlock(block_index + 1, postings);
+		std::rotate(postings, postings + next_block.size, postings + next_block.size + count);
+		count += next_block.size;
+		garbage_bytes_ += next_block.byte_size;
+		block_postings_count_ -= next_block.size;
+		blocks_.erase(blocks_.begin() + block_index + 1);
+	}
+
+	if (count == 0)
+	{
+		blocks_.erase(blocks_.begin() + block_index);
+	}
+	else if (count <= MAX_BLOCK_SIZE)
+	{
+		EncodeBlock(postings, count, blocks_[block_index]);
+		block_postings_count_ += count;
+	}
+	else
+	{
+		const size_t first_count = count / 2;
+		EncodeBlock(postings, first_count, blocks_[block_index]);
+		EncodeBlock(postings + first_count, count - first_count, *blocks_.insert(blocks_.begin() + block_index + 1, Block()));
+		block_postings_count_ += count;
+	}
+
+	if (garbage_bytes_ * 2 > data_.size())
+	{
+		CompactData();
+	}
+}
+
+void PostingList::CompactData()
+{
+	std::vector<uint8_t> data;
+	data.reserve(data_.size() - garbage_bytes_);
+	for (Block& block : blocks_)
+	{
+		const uint32_t offset = static_cast<uint32_t>(data.size());
+		data.insert(data.end(), data_.begin() + block.offset, data_.begin() + block.offset + block.byte_size);
+		block.offset = offset;
+	}
+	data_ = std::move(data);
+	garbage_bytes_ = 0;
+}
+
+const Posting* PostingList::GetTailData() const
+{
+	return borrowed_ != nullptr ? borrowed_ : tail_.data();
+}
+
+size_t PostingList::GetTailSize() const
+{
+	return borrowed_ != nullptr ? borrowed_size_ : tail_.size();
+}
+
+void PostingList::Materialize()
+{
+	if (borrowed_ == nullptr)
+	{
+		return;
+	}
+	tail_.assign(borrowed_, borrowed_ + borrowed_size_);
+	borrowed_ = nullptr;
+	borrowed_size_ = 0;
+}
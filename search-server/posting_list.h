@@ -0,0 +1,163 @@
+#pragma once
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+struct Posting
+{
+	int ordinal;
+	int term_count;
+};
+
+// Список вхождений слова, отсортированный по внутреннему порядковому номеру
+// документа (ordinal). Хранит число вхождений слова, term_freq вычисляется
+// по длине документа.
+//
+// В несжатом режиме все вхождения лежат в непрерывном массиве. В сжатом режиме
+// вхождения упакованы блоками примерно по BLOCK_SIZE: разности номеров и счётчики
+// записаны в varint, для каждого блока хранятся первый и последний номер, что
+// позволяет пропускать блоки без распаковки. Последние неполные BLOCK_SIZE
+// вхождений всегда хранятся несжатыми, поэтому добавление в конец остаётся O(1).
+// Вставка и удаление в середине перепаковывают только свой блок: переполненный
+// блок делится пополам, почти пустой сливается со следующим. Новая упаковка
+// блока дописывается в конец общего массива, а массив уплотняется, когда старые
+// упаковки занимают больше половины.
+//
+// Список может ссылаться на внешний несжатый массив (например, в отображённом
+// в память файле индекса). Такой массив не копируется до первого изменения списка.
+class PostingList
+{
+public:
+
+	static const size_t BLOCK_SIZE = 128;
+	static const size_t MAX_BLOCK_SIZE = 2 * BLOCK_SIZE;
+
+	// Последовательный обход списка с распаковкой по одному блоку. Буфер для
+	// распаковки нужен только сжатому списку.
+	class Cursor
+	{
+	public:
+
+		// Для сжатого списка выделяет собственный буфер.
+		explicit Cursor(const PostingList& postings);
+
+		// Распаковывает блоки в buffer на MAX_BLOCK_SIZE вхождений, который должен
+		// жить дольше курсора.
+		Cursor(const PostingList& postings, Posting* buffer);
+
+		bool IsValid() const
+		{
+			return position_ < size_;
+		}
+
+		const Posting& Get() const
+		{
+			return current_[position_];
+		}
+
+		void Next()
+		{
+			if (++position_ == size_)
+			{
+				LoadNextBlock();
+			}
+		}
+
+		// Переходит к первому вхождению с номером не меньше ordinal. Назад не двигается.
+		void SeekGE(int ordinal);
+
+	private:
+
+		void LoadNextBlock();
+
+		const PostingList* postings_;
+		size_t next_block_ = 0;
+		bool in_tail_ = false;
+		// Текущий блок: распакованный в buffer_ или несжатый хвост.
+		const Posting* current_ = nullptr;
+		size_t position_ = 0;
+		size_t size_ = 0;
+		Posting* buffer_ = nullptr;
+		std::unique_ptr<Posting[]> own_buffer_;
+	};
+
+	PostingList() = default;
+
+	// Список поверх внешнего массива, который должен жить дольше списка.
+	PostingList(const Posting* postings, size_t size, double max_term_freq);
+
+	void Add(int ordinal, int term_count, double term_freq);
+
+	bool Erase(int ordinal);
+
+	// Удаляет за один проход все вхождения документов, отмеченных в removed_ordinals.
+	void Erase(const std::vector<bool>& removed_ordinals);
+
+	bool Contains(int ordinal) const;
+
+	// Верхняя граница term_freq по списку, используется для отсечения при поиске топ-K.
+	// После удалений граница может остаться завышенной, что не влияет на корректность.
+	double GetMaxTermFreq() const;
+
+	void SetCompressed(bool compressed);
+
+	bool IsCompressed() const;
+
+	size_t GetMemoryUsage() const;
+
+	size_t size() const;
+
+	bool empty() const;
+
+private:
+
+	struct Block
+	{
+		int first_ordinal;
+		int last_ordinal;
+		uint32_t offset;
+		uint32_t byte_size;
+		uint32_t size;
+	};
+
+	std::vector<Posting> Decompress() const;
+
+	void Compress(std::vector<Posting> postings);
+
+	void AppendBlock(const Posting* postings, size_t count);
+
+	// Упаковывает вхождения в конец data_ и записывает их границы в block.
+	void EncodeBlock(const Posting* postings, size_t count, Block& block);
+
+	void DecodeBlock(size_t block_index, Posting* output) const;
+
+	// Первый блок, последний номер которого не меньше ordinal.
+	size_t FindBlock(int ordinal) const;
+
+	// Заменяет содержимое блока count вхождениями из postings, буфера размером не меньше
+	// MAX_BLOCK_SIZE + BLOCK_SIZE; пустой блок удаляется, переполненный делится.
+	void ReplaceBlock(size_t block_index, Posting* postings, size_t count);
+
+	// Переписывает data_ без устаревших упаковок блоков.
+	void CompactData();
+
+	const Posting* GetTailData() const;
+
+	size_t GetTailSize() const;
+
+	// Копирует внешний массив в собственную память перед изменением списка.
+	void Materialize();
+
+	bool compressed_ = false;
+	const Posting* borrowed_ = nullptr;
+	size_t borrowed_size_ = 0;
+	std::vector<Block> blocks_;
+	std::vector<uint8_t> data_;
+	// Байты data_, занятые устаревшими упаковками блоков.
+	size_t garbage_bytes_ = 0;
+	size_t block_postings_count_ = 0;
+	std::vector<Posting> tail_;
+	double max_term_freq_ = 0.0;
+};
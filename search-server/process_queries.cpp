@@ -1,25 +1,123 @@
 #include <execution>
+#include <utility>
 #include "process_queries.h"
 
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries)
+{
+    std::vector<std::vector<Document>> answer;
+    ProcessQueriesWindow(search_server, queries, 0, queries.size(), answer);
+    return answer;
+}
+
+std::vector<std::vector<Document>> ProcessQueries(
+    const SnapshotSearchServer& search_server,
+    const std::vector<std::string>& queries)
+{
+    const auto snapshot = search_server.GetSnapshot();
+    return ProcessQueries(*snapshot, queries);
+}
+
+std::vector<std::vector<Document>> ProcessQueries(
+    ThreadPool& pool,
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries)
 {
     std::vector<std::vector<Document>> answer(queries.size());
-    std::transform(std::execution::par, queries.begin(), queries.end(), answer.begin(),
-        [&search_server](const std::string& query) {return search_server.FindTopDocuments(query); });
+    pool.ParallelFor(queries.size(), [&](size_t i) {
+        answer[i] = search_server.FindTopDocuments(pool, queries[i]);
+    });
     return answer;
 }
 
-std::list<Document> ProcessQueriesJoined(
-    const SearchServer& search_server, 
+std::vector<std::vector<Document>> ProcessQueriesBatched(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries)
+{
+    return search_server.FindTopDocumentsBatch(queries);
+}
+
+std::vector<std::vector<Document>> ProcessQueriesBatched(
+    const SnapshotSearchServer& search_server,
     const std::vector<std::string>& queries)
 {
-    std::vector<std::vector<Document>> result_process_queries = ProcessQueries(search_server, queries);
-    std::list<Document> result;
-    for (auto& elem : result_process_queries) {
-        std::move(elem.begin(), elem.end(), std::back_inserter(result));
+    const auto snapshot = search_server.GetSnapshot();
+    return snapshot->FindTopDocumentsBatch(queries);
+}
+
+void ProcessQueriesWindow(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    size_t first, size_t last,
+    std::vector<std::vector<Document>>& results)
+{
+    results.resize(last - first);
+    std::transform(std::execution::par, queries.begin() + first, queries.begin() + last, results.begin(),
+        [&search_server](const std::string& query) {return search_server.FindTopDocuments(query); });
+}
+
+JoinedDocuments::JoinedDocuments(
+    const SearchServer& search_server,
+    std::vector<std::string> queries,
+    size_t window_size)
+    : search_server_(search_server)
+    , queries_(std::move(queries))
+    , window_size_(std::max<size_t>(window_size, 1))
+{}
+
+JoinedDocuments::Iterator JoinedDocuments::begin()
+{
+    if (!started_) {
+        started_ = true;
+        SkipEmptyResults();
     }
-    return result;
-}
\ No newline at end of file
+    return Iterator(this);
+}
+
+JoinedDocuments::Iterator JoinedDocuments::end()
+{
+    return Iterator();
+}
+
+const Document& JoinedDocuments::Current() const
+{
+    return window_[query_][position_];
+}
+
+void JoinedDocuments::Advance()
+{
+    ++position_;
+    SkipEmptyResults();
+}
+
+bool JoinedDocuments::IsEnd() const
+{
+    return query_ == window_.size() && next_query_ == queries_.size();
+}
+
+void JoinedDocuments::SkipEmptyResults()
+{
+    while (true) {
+        while (query_ < window_.size() && position_ == window_[query_].size()) {
+            ++query_;
+            position_ = 0;
+        }
+        if (query_ < window_.size() || next_query_ == queries_.size()) {
+            return;
+        }
+        const size_t last = std::min(queries_.size(), next_query_ + window_size_);
+        ProcessQueriesWindow(search_server_, queries_, next_query_, last, window_);
+        next_query_ = last;
+        query_ = 0;
+        position_ = 0;
+    }
+}
+
+JoinedDocuments ProcessQueriesJoined(
+    const SearchServer& search_server, 
+    std::vector<std::string> queries)
+{
+    return JoinedDocuments(search_server, std::move(queries));
+}
@@ -1,14 +1,174 @@
 #pragma once
+#include <algorithm>
+#include <cstddef>
+#include <execution>
+#include <iterator>
+#include <string>
 #include <vector>
-#include <list>
 
 #include "document.h"
 #include "search_server.h"
+#include "snapshot_search_server.h"
+#include "thread_pool.h"
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
 
-std::list<Document> ProcessQueriesJoined(
+// Все запросы выполняются на одном снимке индекса.
+std::vector<std::vector<Document>> ProcessQueries(
+    const SnapshotSearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+// Запросы выполняются в пуле потоков; крупные запросы дополнительно делятся
+// между его потоками, не создавая новых.
+std::vector<std::vector<Document>> ProcessQueries(
+    ThreadPool& pool,
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+// Запросы выполняются пакетом с общим обходом списков вхождений, см. SearchServer::FindTopDocumentsBatch.
+std::vector<std::vector<Document>> ProcessQueriesBatched(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+std::vector<std::vector<Document>> ProcessQueriesBatched(
+    const SnapshotSearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+// Число запросов, которые выполняются параллельно перед выдачей их результатов.
+const size_t PROCESS_QUERIES_WINDOW_SIZE = 256;
+
+// Выполняет запросы [first, last) параллельно, results[i] — ответ на запрос first + i.
+void ProcessQueriesWindow(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    size_t first, size_t last,
+    std::vector<std::vector<Document>>& results);
+
+// Выполняет запросы окнами по window_size и передаёт ответ на каждый запрос
+// в consumer(query_index, documents) в порядке запросов. Ответы окна выдаются,
+// как только окно выполнено, в памяти одновременно держатся ответы одного окна.
+// Вектор documents можно забрать перемещением.
+template <typename Consumer>
+void ProcessQueriesStreamed(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    Consumer consumer,
+    size_t window_size = PROCESS_QUERIES_WINDOW_SIZE)
+{
+    window_size = std::max<size_t>(window_size, 1);
+    std::vector<std::vector<Document>> window;
+    for (size_t first = 0; first < queries.size(); first += window_size) {
+        const size_t last = std::min(queries.size(), first + window_size);
+        ProcessQueriesWindow(search_server, queries, first, last, window);
+        for (size_t i = first; i < last; ++i) {
+            consumer(i, window[i - first]);
+        }
+    }
+}
+
+// Ответы на запросы, склеенные в одну последовательность в порядке запросов.
+// Запросы выполняются лениво, окнами, по мере продвижения итератора, поэтому
+// первые документы доступны до выполнения всего набора. Обходится один раз;
+// запросы хранятся в последовательности, сервер должен жить дольше неё.
+// Перемещение последовательности делает недействительными её итераторы.
+class JoinedDocuments
+{
+public:
+
+    class Iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Document;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Document*;
+        using reference = const Document&;
+
+        Iterator() = default;
+
+        explicit Iterator(JoinedDocuments* documents)
+            : documents_(documents)
+        {}
+
+        reference operator*() const
+        {
+            return documents_->Current();
+        }
+
+        pointer operator->() const
+        {
+            return &documents_->Current();
+        }
+
+        Iterator& operator++()
+        {
+            documents_->Advance();
+            return *this;
+        }
+
+        void operator++(int)
+        {
+            documents_->Advance();
+        }
+
+        bool operator==(const Iterator& other) const
+        {
+            return IsEnd() == other.IsEnd();
+        }
+
+        bool operator!=(const Iterator& other) const
+        {
+            return !(*this == other);
+        }
+
+    private:
+
+        bool IsEnd() const
+        {
+            return documents_ == nullptr || documents_->IsEnd();
+        }
+
+        JoinedDocuments* documents_ = nullptr;
+    };
+
+    JoinedDocuments(
+        const SearchServer& search_server,
+        std::vector<std::string> queries,
+        size_t window_size = PROCESS_QUERIES_WINDOW_SIZE);
+
+    JoinedDocuments(const JoinedDocuments&) = delete;
+    JoinedDocuments& operator=(const JoinedDocuments&) = delete;
+
+    JoinedDocuments(JoinedDocuments&&) = default;
+
+    Iterator begin();
+
+    Iterator end();
+
+private:
+
+    const Document& Current() const;
+
+    void Advance();
+
+    bool IsEnd() const;
+
+    // Пропускает пустые ответы, при необходимости выполняя следующее окно.
+    void SkipEmptyResults();
+
+    const SearchServer& search_server_;
+    std::vector<std::string> queries_;
+    size_t window_size_;
+    size_t next_query_ = 0;
+    bool started_ = false;
+    std::vector<std::vector<Document>> window_;
+    size_t query_ = 0;
+    size_t position_ = 0;
+};
+
+// Документы всех ответов подряд в порядке запросов, без промежуточных контейнеров.
+JoinedDocuments ProcessQueriesJoined(
     const SearchServer& search_server,
-    const std::vector<std::string>& queries);
\ No newline at end of file
+    std::vector<std::string> queries);
\ No newline at end of file
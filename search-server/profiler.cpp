@@ -0,0 +1,494 @@
+#include "profiler.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+	// Замеры одной точки в одном потоке. Пишет только поток-владелец, поэтому
+	// вместо атомарных сложений достаточно чтения и записи.
+	struct SiteData
+	{
+		SiteData()
+		{
+			Clear();
+		}
+
+		void Clear()
+		{
+			count.store(0, std::memory_order_relaxed);
+			total_ns.store(0, std::memory_order_relaxed);
+			min_ns.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+			max_ns.store(0, std::memory_order_relaxed);
+			value.store(0, std::memory_order_relaxed);
+			for (auto& bucket : histogram)
+			{
+				bucket.store(0, std::memory_order_relaxed);
+			}
+		}
+
+		std::atomic<uint64_t> count;
+		std::atomic<uint64_t> total_ns;
+		std::atomic<uint64_t> min_ns;
+		std::atomic<uint64_t> max_ns;
+		std::atomic<int64_t> value;
+		std::array<std::atomic<uint64_t>, Profiler::HISTOGRAM_BUCKET_COUNT> histogram;
+	};
+
+	struct TraceEvent
+	{
+		size_t site_index;
+		uint64_t start_ns;
+		uint64_t duration_ns;
+	};
+
+	// События пишутся по порядку, size публикует записанные.
+	struct TraceBuffer
+	{
+		explicit TraceBuffer(size_t capacity)
+			: events(new TraceEvent[capacity])
+			, capacity(capacity)
+		{
+		}
+
+		std::unique_ptr<TraceEvent[]> events;
+		const size_t capacity;
+		std::atomic<size_t> size{ 0 };
+	};
+
+	struct ThreadData
+	{
+		ThreadData()
+		{
+			for (auto& site : sites)
+			{
+				site.store(nullptr, std::memory_order_relaxed);
+			}
+		}
+
+		~ThreadData()
+		{
+			for (auto& site : sites)
+			{
+				delete site.load(std::memory_order_relaxed);
+			}
+		}
+
+		uint32_t thread_number = 0;
+		// Поколение замеров, к которому относятся данные; меняется при сбросе.
+		std::atomic<uint64_t> generation{ 0 };
+		std::array<std::atomic<SiteData*>, Profiler::MAX_SITE_COUNT> sites;
+
+		// Буфер трассировки меняет только владелец при смене поколения, а выгрузка
+		// держит копию указателя, поэтому старый буфер живёт до конца выгрузки.
+		std::mutex trace_mutex;
+		std::shared_ptr<TraceBuffer> trace;
+		TraceBuffer* owner_trace = nullptr;
+	};
+
+	struct Registry
+	{
+		const Profiler::Clock::time_point origin = Profiler::Clock::now();
+
+		std::mutex mutex;
+		std::array<const char*, Profiler::MAX_SITE_COUNT> site_names{};
+		std::array<Profiler::SiteKind, Profiler::MAX_SITE_COUNT> site_kinds{};
+		size_t site_count = 0;
+		std::vector<std::shared_ptr<ThreadData>> threads;
+		uint32_t next_thread_number = 1;
+
+		std::atomic<uint64_t> generation{ 1 };
+		std::atomic<size_t> trace_capacity{ 0 };
+	};
+
+	Registry& GetRegistry()
+	{
+		static Registry registry;
+		return registry;
+	}
+
+	std::shared_ptr<ThreadData> RegisterThread()
+	{
+		Registry& registry = GetRegistry();
+		auto data = std::make_shared<ThreadData>();
+		std::lock_guard guard(registry.mutex);
+		data->thread_number = registry.next_thread_number++;
+		registry.threads.push_back(data);
+		return data;
+	}
+
+	// Данные текущего потока, приведённые к текущему поколению.
+	ThreadData& GetThreadData()
+	{
+		thread_local const std::shared_ptr<ThreadData> data = RegisterThread();
+		const uint64_t generation = GetRegistry().generation.load(std::memory_order_acquire);
+		if (data->generation.load(std::memory_order_relaxed) != generation)
+		{
+			for (auto& site : data->sites)
+			{
+				if (SiteData* site_data = site.load(std::memory_order_relaxed))
+				{
+					site_data->Clear();
+				}
+			}
+			const size_t trace_capacity = GetRegistry().trace_capacity.load(std::memory_order_relaxed);
+			auto trace = trace_capacity > 0 ? std::make_shared<TraceBuffer>(trace_capacity) : nullptr;
+			data->owner_trace = trace.get();
+			{
+				std::lock_guard guard(data->trace_mutex);
+				data->trace = std::move(trace);
+			}
+			data->generation.store(generation, std::memory_order_release);
+		}
+		return *data;
+	}
+
+	SiteData& GetSiteData(ThreadData& data, size_t site_index)
+	{
+		SiteData* site_data = data.sites[site_index].load(std::memory_order_relaxed);
+		if (site_data == nullptr)
+		{
+			site_data = new SiteData;
+			data.sites[site_index].store(site_data, std::memory_order_release);
+		}
+		return *site_data;
+	}
+
+	uint64_t ToNanoseconds(Profiler::Clock::duration duration)
+	{
+		return static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+	}
+
+	size_t GetHistogramBucket(uint64_t ns)
+	{
+		size_t bucket = 0;
+		while (ns != 0 && bucket + 1 < Profiler::HISTOGRAM_BUCKET_COUNT)
+		{
+			ns >>= 1;
+			++bucket;
+		}
+		return bucket;
+	}
+
+	void Increase(std::atomic<uint64_t>& value, uint64_t delta)
+	{
+		value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+	}
+
+	// Данные потоков текущего поколения; вызывается под registry.mutex.
+	template <typename Function>
+	void ForEachCurrentThread(Registry& registry, Function function)
+	{
+		const uint64_t generation = registry.generation.load(std::memory_order_acquire);
+		for (const auto& data : registry.threads)
+		{
+			if (data->generation.load(std::memory_order_acquire) == generation)
+			{
+				function(*data);
+			}
+		}
+	}
+
+	void Record(size_t site_index, Profiler::Clock::time_point start_time, Profiler::Clock::time_point end_time)
+	{
+		if (site_index >= Profiler::MAX_SITE_COUNT)
+		{
+			return;
+		}
+		ThreadData& data = GetThreadData();
+		SiteData& site_data = GetSiteData(data, site_index);
+		const uint64_t duration_ns = ToNanoseconds(end_time - start_time);
+		Increase(site_data.count, 1);
+		Increase(site_data.total_ns, duration_ns);
+		site_data.min_ns.store(std::min(site_data.min_ns.load(std::memory_order_relaxed), duration_ns), std::memory_order_relaxed);
+		site_data.max_ns.store(std::max(site_data.max_ns.load(std::memory_order_relaxed), duration_ns), std::memory_order_relaxed);
+		Increase(site_data.histogram[GetHistogramBucket(duration_ns)], 1);
+
+		if (TraceBuffer* trace = data.owner_trace)
+		{
+			const size_t size = trace->size.load(std::memory_order_relaxed);
+			if (size < trace->capacity)
+			{
+				trace->events[size] = { site_index, ToNanoseconds(start_time - GetRegistry().origin), duration_ns };
+				trace->size.store(size + 1, std::memory_order_release);
+			}
+		}
+	}
+
+	void WriteJsonString(std::ostream& os, const std::string& text)
+	{
+		static const char* const HEX_DIGITS = "0123456789abcdef";
+		os << '"';
+		for (const char c : text)
+		{
+			if (c == '"' || c == '\\')
+			{
+				os << '\\' << c;
+			}
+			else if (static_cast<unsigned char>(c) < 32)
+			{
+				os << "\\u00" << HEX_DIGITS[c >> 4] << HEX_DIGITS[c & 15];
+			}
+			else
+			{
+				os << c;
+			}
+		}
+		os << '"';
+	}
+
+	void WriteMicroseconds(std::ostream& os, uint64_t ns)
+	{
+		const std::string fraction = std::to_string(ns % 1000);
+		os << ns / 1000 << '.' << std::string(3 - fraction.size(), '0') << fraction;
+	}
+}
+
+Profiler::Site::Site(const char* name, SiteKind kind)
+	: index_(MAX_SITE_COUNT)
+{
+	// Одно имя может стоять в нескольких местах, например в разных экземплярах шаблона.
+	Registry& registry = GetRegistry();
+	std::lock_guard guard(registry.mutex);
+	for (size_t i = 0; i < registry.site_count; ++i)
+	{
+		if (registry.site_kinds[i] == kind && std::strcmp(registry.site_names[i], name) == 0)
+		{
+			index_ = i;
+			return;
+		}
+	}
+	if (registry.site_count < MAX_SITE_COUNT)
+	{
+		index_ = registry.site_count++;
+		registry.site_names[index_] = name;
+		registry.site_kinds[index_] = kind;
+	}
+}
+
+size_t Profiler::Site::GetIndex() const
+{
+	return index_;
+}
+
+Profiler::Scope::Scope(const Site& site)
+	: site_index_(site.GetIndex())
+	, start_time_(Clock::now())
+{
+}
+
+Profiler::Scope::~Scope()
+{
+	Record(site_index_, start_time_, Clock::now());
+}
+
+void Profiler::AddToCounter(const Site& site, int64_t value)
+{
+	if (site.GetIndex() >= MAX_SITE_COUNT)
+	{
+		return;
+	}
+	SiteData& site_data = GetSiteData(GetThreadData(), site.GetIndex());
+	site_data.value.store(site_data.value.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	Increase(site_data.count, 1);
+}
+
+void Profiler::RecordScope(const Site& site, Clock::time_point start_time, Clock::time_point end_time)
+{
+	Record(site.GetIndex(), start_time, end_time);
+}
+
+uint64_t Profiler::ScopeStats::GetPercentileNs(double fraction) const
+{
+	if (count == 0)
+	{
+		return 0;
+	}
+	const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * static_cast<double>(count) + 0.5));
+	uint64_t passed = 0;
+	for (size_t bucket = 0; bucket + 1 < HISTOGRAM_BUCKET_COUNT; ++bucket)
+	{
+		passed += histogram[bucket];
+		if (passed >= rank)
+		{
+			const uint64_t upper_bound = bucket == 0 ? 0 : (uint64_t(1) << bucket) - 1;
+			return std::min(upper_bound, max_ns);
+		}
+	}
+	return max_ns;
+}
+
+Profiler::Report Profiler::Collect()
+{
+	Registry& registry = GetRegistry();
+	std::lock_guard guard(registry.mutex);
+
+	std::vector<ScopeStats> scopes(registry.site_count);
+	std::vector<CounterStats> counters(registry.site_count);
+	std::vector<bool> is_used(registry.site_count, false);
+	ForEachCurrentThread(registry, [&](const ThreadData& data)
+		{
+			for (size_t i = 0; i < registry.site_count; ++i)
+			{
+				const SiteData* site_data = data.sites[i].load(std::memory_order_acquire);
+				const uint64_t count = site_data ? site_data->count.load(std::memory_order_relaxed) : 0;
+				if (count == 0)
+				{
+					continue;
+				}
+				if (registry.site_kinds[i] == SiteKind::COUNTER)
+				{
+					counters[i].value += site_data->value.load(std::memory_order_relaxed);
+				}
+				else
+				{
+					ScopeStats& stats = scopes[i];
+					const uint64_t min_ns = site_data->min_ns.load(std::memory_order_relaxed);
+					stats.min_ns = is_used[i] ? std::min(stats.min_ns, min_ns) : min_ns;
+					stats.max_ns = std::max(stats.max_ns, site_data->max_ns.load(std::memory_order_relaxed));
+					stats.count += count;
+					stats.total_ns += site_data->total_ns.load(std::memory_order_relaxed);
+					for (size_t bucket = 0; bucket < HISTOGRAM_BUCKET_COUNT; ++bucket)
+					{
+						stats.histogram[bucket] += site_data->histogram[bucket].load(std::memory_order_relaxed);
+					}
+				}
+				is_used[i] = true;
+			}
+		});
+
+	Report report;
+	for (size_t i = 0; i < registry.site_count; ++i)
+	{
+		if (!is_used[i])
+		{
+			continue;
+		}
+		if (registry.site_kinds[i] == SiteKind::COUNTER)
+		{
+			counters[i].name = registry.site_names[i];
+			report.counters.push_back(std::move(counters[i]));
+		}
+		else
+		{
+			scopes[i].name = registry.site_names[i];
+			report.scopes.push_back(std::move(scopes[i]));
+		}
+	}
+	std::sort(report.scopes.begin(), report.scopes.end(), [](const ScopeStats& lhs, const ScopeStats& rhs)
+		{
+			return lhs.name < rhs.name;
+		});
+	std::sort(report.counters.begin(), report.counters.end(), [](const CounterStats& lhs, const CounterStats& rhs)
+		{
+			return lhs.name < rhs.name;
+		});
+	return report;
+}
+
+void Profiler::Reset()
+{
+	Registry& registry = GetRegistry();
+	std::lock_guard guard(registry.mutex);
+	// Данные завершившихся потоков больше никому не нужны.
+	registry.threads.erase(std::remove_if(registry.threads.begin(), registry.threads.end(),
+		[](const std::shared_ptr<ThreadData>& data)
+		{
+			return data.use_count() == 1;
+		}), registry.threads.end());
+	registry.generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+void Profiler::EnableTrace(size_t max_events_per_thread)
+{
+	GetRegistry().trace_capacity.store(max_events_per_thread, std::memory_order_relaxed);
+	Reset();
+}
+
+void Profiler::WriteJson(std::ostream& os)
+{
+	const Report report = Collect();
+	os << "{\"scopes\": [";
+	bool is_first = true;
+	for (const ScopeStats& stats : report.scopes)
+	{
+		os << (is_first ? "" : ", ") << "{\"name\": ";
+		WriteJsonString(os, stats.name);
+		os << ", \"count\": " << stats.count
+			<< ", \"total_ns\": " << stats.total_ns
+			<< ", \"min_ns\": " << stats.min_ns
+			<< ", \"max_ns\": " << stats.max_ns
+			<< ", \"p50_ns\": " << stats.GetPercentileNs(0.5)
+			<< ", \"p90_ns\": " << stats.GetPercentileNs(0.9)
+			<< ", \"p99_ns\": " << stats.GetPercentileNs(0.99)
+			<< ", \"histogram\": [";
+		size_t bucket_count = HISTOGRAM_BUCKET_COUNT;
+		while (bucket_count > 0 && stats.histogram[bucket_count - 1] == 0)
+		{
+			--bucket_count;
+		}
+		for (size_t bucket = 0; bucket < bucket_count; ++bucket)
+		{
+			os << (bucket == 0 ? "" : ", ") << stats.histogram[bucket];
+		}
+		os << "]}";
+		is_first = false;
+	}
+	os << "], \"counters\": [";
+	is_first = true;
+	for (const CounterStats& stats : report.counters)
+	{
+		os << (is_first ? "" : ", ") << "{\"name\": ";
+		WriteJsonString(os, stats.name);
+		os << ", \"value\": " << stats.value << "}";
+		is_first = false;
+	}
+	os << "]}";
+}
+
+void Profiler::WriteChromeTrace(std::ostream& os)
+{
+	Registry& registry = GetRegistry();
+	std::lock_guard guard(registry.mutex);
+	os << "{\"traceEvents\": [";
+	bool is_first = true;
+	ForEachCurrentThread(registry, [&](ThreadData& data)
+		{
+			std::shared_ptr<TraceBuffer> trace;
+			{
+				std::lock_guard trace_guard(data.trace_mutex);
+				trace = data.trace;
+			}
+			if (!trace)
+			{
+				return;
+			}
+			const size_t size = trace->size.load(std::memory_order_acquire);
+			for (size_t i = 0; i < size; ++i)
+			{
+				const TraceEvent& event = trace->events[i];
+				os << (is_first ? "" : ",\n") << "{\"name\": ";
+				WriteJsonString(os, registry.site_names[event.site_index]);
+				os << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << data.thread_number << ", \"ts\": ";
+				WriteMicroseconds(os, event.start_ns);
+				os << ", \"dur\": ";
+				WriteMicroseconds(os, event.duration_ns);
+				os << "}";
+				is_first = false;
+			}
+		});
+	os << "], \"displayTimeUnit\": \"ns\"}";
+}
+
+std::ostream& operator<<(std::ostream& os, const Profiler::ScopeStats& stats)
+{
+	return os << "{ name = " << stats.name
+		<< ", count = " << stats.count
+		<< ", total = " << stats.total_ns << "ns"
+		<< ", min = " << stats.min_ns << "ns"
+		<< ", max = " << stats.max_ns << "ns"
+		<< ", p50 = " << stats.GetPercentileNs(0.5) << "ns"
+		<< ", p99 = " << stats.GetPercentileNs(0.99) << "ns }";
+}
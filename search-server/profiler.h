@@ -0,0 +1,138 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Инструментирование горячего пути поиска.
+//
+// PROFILE_SCOPE("search.parse") измеряет время до конца области видимости с точностью
+// до наносекунды, PROFILE_COUNTER("search.terms", n) прибавляет n к именованному
+// счётчику. Замеры копятся в данных своего потока без блокировок; Profiler::Collect
+// складывает их по всем потокам: число вызовов, суммарное, наименьшее и наибольшее
+// время и гистограмму по степеням двойки наносекунд. При включённой трассировке
+// каждый вызов области ещё и пишется в буфер потока для выгрузки в формате
+// Chrome trace (chrome://tracing, Perfetto).
+//
+// Макросы работают, только если при сборке определён SEARCH_SERVER_PROFILE, иначе
+// они ничего не делают. Класс Profiler доступен всегда.
+#define PROFILE_CONCAT_INTERNAL(X, Y) X ## Y
+#define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
+
+#ifdef SEARCH_SERVER_PROFILE
+#define PROFILE_SCOPE(name) \
+	static const Profiler::Site PROFILE_CONCAT(profileSite, __LINE__)((name), Profiler::SiteKind::SCOPE); \
+	const Profiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(PROFILE_CONCAT(profileSite, __LINE__))
+#define PROFILE_COUNTER(name, value) \
+	do \
+	{ \
+		static const Profiler::Site profile_counter_site((name), Profiler::SiteKind::COUNTER); \
+		Profiler::AddToCounter(profile_counter_site, (value)); \
+	} while (false)
+#else
+#define PROFILE_SCOPE(name) static_cast<void>(0)
+#define PROFILE_COUNTER(name, value) static_cast<void>(0)
+#endif
+
+class Profiler
+{
+public:
+
+	using Clock = std::chrono::steady_clock;
+
+	// Точек измерения не больше MAX_SITE_COUNT, лишние не учитываются.
+	static const size_t MAX_SITE_COUNT = 128;
+	// Интервал i гистограммы — длительности из [2^(i-1), 2^i) нс, последний открыт сверху.
+	static const size_t HISTOGRAM_BUCKET_COUNT = 40;
+
+	enum class SiteKind
+	{
+		SCOPE,
+		COUNTER
+	};
+
+	// Именованная точка измерения. Регистрируется один раз, обычно как статическая
+	// переменная в месте замера; name должно жить до конца программы.
+	class Site
+	{
+	public:
+
+		Site(const char* name, SiteKind kind);
+
+		size_t GetIndex() const;
+
+	private:
+
+		size_t index_;
+	};
+
+	class Scope
+	{
+	public:
+
+		explicit Scope(const Site& site);
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+		~Scope();
+
+	private:
+
+		size_t site_index_;
+		Clock::time_point start_time_;
+	};
+
+	struct ScopeStats
+	{
+		std::string name;
+		uint64_t count = 0;
+		uint64_t total_ns = 0;
+		uint64_t min_ns = 0;
+		uint64_t max_ns = 0;
+		std::array<uint64_t, HISTOGRAM_BUCKET_COUNT> histogram{};
+
+		// Верхняя граница интервала гистограммы, в котором лежит перцентиль.
+		uint64_t GetPercentileNs(double fraction) const;
+	};
+
+	struct CounterStats
+	{
+		std::string name;
+		int64_t value = 0;
+	};
+
+	struct Report
+	{
+		std::vector<ScopeStats> scopes;
+		std::vector<CounterStats> counters;
+	};
+
+	static void AddToCounter(const Site& site, int64_t value);
+
+	// Записывает замер области с заданными началом и концом в данные текущего потока.
+	static void RecordScope(const Site& site, Clock::time_point start_time, Clock::time_point end_time);
+
+	// Сумма замеров всех потоков по точкам, которые хоть раз сработали. Можно вызывать
+	// во время замеров: незаконченные в этот момент записи могут не попасть в отчёт.
+	static Report Collect();
+
+	// Обнуляет замеры и буферы трассировки. Потоки обнуляют свои данные при следующем
+	// замере, поэтому замер, идущий во время сброса, может быть потерян.
+	static void Reset();
+
+	// Включает трассировку с буфером на max_events_per_thread событий в каждом потоке
+	// и сбрасывает замеры; 0 выключает трассировку. Заполненный буфер перестаёт пополняться.
+	static void EnableTrace(size_t max_events_per_thread);
+
+	static void WriteJson(std::ostream& os);
+
+	// Формат Trace Event: {"traceEvents": [{"ph": "X", ...}, ...]}, время в микросекундах.
+	static void WriteChromeTrace(std::ostream& os);
+};
+
+std::ostream& operator<<(std::ostream& os, const Profiler::ScopeStats& stats);
@@ -0,0 +1,101 @@
+#include "query_cache.h"
+#include <functional>
+
+bool QueryCache::Key::operator==(const Key& other) const
+{
+	return status == other.status && max_result_count == other.max_result_count && words == other.words;
+}
+
+size_t QueryCache::KeyHasher::operator()(const Key& key) const
+{
+	size_t hash = std::hash<std::string>()(key.words);
+	hash = hash * 37 + static_cast<size_t>(key.status);
+	hash = hash * 37 + key.max_result_count;
+	return hash;
+}
+
+QueryCache::QueryCache(size_t capacity)
+	: capacity_(capacity)
+{
+	positions_.reserve(capacity);
+}
+
+bool QueryCache::Find(const Key& key, uint64_t index_version, std::vector<Document>& documents)
+{
+	std::lock_guard guard(mutex_);
+	const auto position = positions_.find(key);
+	if (position == positions_.end())
+	{
+		++stats_.misses;
+		return false;
+	}
+	const auto entry = position->second;
+	if (entry->index_version != index_version)
+	{
+		positions_.erase(position);
+		entries_.erase(entry);
+		++stats_.invalidations;
+		++stats_.misses;
+		return false;
+	}
+	entries_.splice(entries_.begin(), entries_, entry);
+	++stats_.hits;
+	documents = entry->documents;
+	return true;
+}
+
+void QueryCache::Insert(Key key, uint64_t index_version, std::vector<Document> documents)
+{
+	if (capacity_ == 0)
+	{
+		return;
+	}
+	std::lock_guard guard(mutex_);
+	const auto position = positions_.find(key);
+	if (position != positions_.end())
+	{
+		// Тот же запрос мог быть вычислен параллельно в другом потоке.
+		const auto entry = position->second;
+		entry->index_version = index_version;
+		entry->documents = std::move(documents);
+		entries_.splice(entries_.begin(), entries_, entry);
+		return;
+	}
+	if (entries_.size() == capacity_)
+	{
+		positions_.erase(entries_.back().key);
+		entries_.pop_back();
+		++stats_.evictions;
+	}
+	entries_.push_front({ std::move(key), index_version, std::move(documents) });
+	positions_.emplace(entries_.front().key, entries_.begin());
+}
+
+void QueryCache::Clear()
+{
+	std::lock_guard guard(mutex_);
+	positions_.clear();
+	entries_.clear();
+}
+
+QueryCache::Stats QueryCache::GetStats() const
+{
+	std::lock_guard guard(mutex_);
+	Stats stats = stats_;
+	stats.size = entries_.size();
+	return stats;
+}
+
+size_t QueryCache::GetCapacity() const
+{
+	return capacity_;
+}
+
+std::ostream& operator<<(std::ostream& os, const QueryCache::Stats& stats)
+{
+	return os << "{ hits = " << stats.hits
+		<< ", misses = " << stats.misses
+		<< ", evictions = " << stats.evictions
+		<< ", invalidations = " << stats.invalidations
+		<< ", size = " << stats.size << " }";
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+
+// Ограниченный кеш результатов поиска с вытеснением давно не использованных
+// записей (LRU). Каждая запись помнит версию индекса, на которой была получена;
+// запись другой версии считается устаревшей и удаляется при обращении.
+// Методы потокобезопасны.
+class QueryCache
+{
+public:
+
+	// Нормализованный запрос: отсортированные плюс-слова, затем минус-слова с префиксом '-'.
+	struct Key
+	{
+		std::string words;
+		DocumentStatus status = DocumentStatus::ACTUAL;
+		size_t max_result_count = 0;
+
+		bool operator==(const Key& other) const;
+	};
+
+	struct Stats
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+		uint64_t invalidations = 0;
+		size_t size = 0;
+	};
+
+	explicit QueryCache(size_t capacity);
+
+	// Копирует найденный результат в documents, переиспользуя его память.
+	bool Find(const Key& key, uint64_t index_version, std::vector<Document>& documents);
+
+	void Insert(Key key, uint64_t index_version, std::vector<Document> documents);
+
+	void Clear();
+
+	Stats GetStats() const;
+
+	size_t GetCapacity() const;
+
+private:
+
+	struct KeyHasher
+	{
+		size_t operator()(const Key& key) const;
+	};
+
+	struct Entry
+	{
+		Key key;
+		uint64_t index_version;
+		std::vector<Document> documents;
+	};
+
+	mutable std::mutex mutex_;
+	size_t capacity_;
+	// Начало списка — последние использованные записи.
+	std::list<Entry> entries_;
+	std::unordered_map<Key, std::list<Entry>::iterator, KeyHasher> positions_;
+	Stats stats_;
+};
+
+std::ostream& operator<<(std::ostream& os, const QueryCache::Stats& stats);
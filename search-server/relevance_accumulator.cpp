@@ -0,0 +1,22 @@
+#include "relevance_accumulator.h"
+
+void RelevanceAccumulator::Reset(size_t ordinal_count)
+{
+	for (const int ordinal : touched_)
+	{
+		relevances_[ordinal] = 0.0;
+		is_touched_[ordinal] = false;
+	}
+	touched_.clear();
+
+	if (relevances_.size() < ordinal_count)
+	{
+		relevances_.resize(ordinal_count, 0.0);
+		is_touched_.resize(ordinal_count, false);
+	}
+}
+
+const std::vector<int>& RelevanceAccumulator::GetTouched() const
+{
+	return touched_;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+// Плотный накопитель релевантности, индексируемый порядковым номером документа.
+// Хранит список затронутых номеров, поэтому очистка между запросами стоит
+// O(число найденных документов), а память переиспользуется.
+class RelevanceAccumulator
+{
+public:
+
+	void Reset(size_t ordinal_count);
+
+	void Add(int ordinal, double relevance)
+	{
+		if (!is_touched_[ordinal])
+		{
+			is_touched_[ordinal] = true;
+			touched_.push_back(ordinal);
+		}
+		relevances_[ordinal] += relevance;
+	}
+
+	double GetRelevance(int ordinal) const
+	{
+		return relevances_[ordinal];
+	}
+
+	const std::vector<int>& GetTouched() const;
+
+private:
+
+	std::vector<double> relevances_;
+	// Отдельный признак, а не нулевая релевантность: вклад слова из всех документов равен нулю.
+	std::vector<bool> is_touched_;
+	std::vector<int> touched_;
+};
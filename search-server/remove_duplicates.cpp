@@ -1,32 +1,108 @@
 #include "remove_duplicates.h"
 
-#include <set>
+#include <algorithm>
+#include <cstdint>
+#include <execution>
+#include <iostream>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	// 128-битный отпечаток набора слов документа. Совпадение отпечатков ещё
+	// не означает совпадения наборов, поэтому наборы затем сравниваются точно.
+	struct Fingerprint
+	{
+		uint64_t low = 0;
+		uint64_t high = 0;
+
+		bool operator==(const Fingerprint& other) const
+		{
+			return low == other.low && high == other.high;
+		}
+	};
+
+	struct FingerprintHasher
+	{
+		size_t operator()(const Fingerprint& fingerprint) const
+		{
+			return static_cast<size_t>(fingerprint.low);
+		}
+	};
+
+	uint64_t MixBits(uint64_t value)
+	{
+		value ^= value >> 30;
+		value *= 0xbf58476d1ce4e5b9ULL;
+		value ^= value >> 27;
+		value *= 0x94d049bb133111ebULL;
+		value ^= value >> 31;
+		return value;
+	}
+
+	// Половины отпечатка считаются с разными начальными значениями и множителями.
+	Fingerprint ComputeFingerprint(const std::vector<int>& word_ids)
+	{
+		Fingerprint fingerprint{ 0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL ^ word_ids.size() };
+		for (const int word_id : word_ids)
+		{
+			const uint64_t value = static_cast<uint32_t>(word_id);
+			fingerprint.low = MixBits(fingerprint.low ^ value) * 0x100000001b3ULL;
+			fingerprint.high = MixBits(fingerprint.high + value * 0xff51afd7ed558ccdULL);
+		}
+		return fingerprint;
+	}
+}
 
 void RemoveDuplicates(SearchServer& search_server)
 {
-	std::vector<int> documents_to_remove;
-	std::set<std::set<std::string_view>> first_unique_documents;
+	const std::vector<int> document_ids(search_server.begin(), search_server.end());
 
-	for (const int document_id : search_server)
+	// Отпечатки наборов слов считаются параллельно.
+	std::vector<Fingerprint> fingerprints(document_ids.size());
+	std::transform(std::execution::par, document_ids.begin(), document_ids.end(), fingerprints.begin(),
+		[&search_server](int document_id)
+		{
+			thread_local std::vector<int> word_ids;
+			search_server.GetDocumentWordIds(document_id, word_ids);
+			return ComputeFingerprint(word_ids);
+		});
+
+	// Документы обходятся по возрастанию id, поэтому из группы дубликатов
+	// остаётся документ с наименьшим id. Для отпечатка хранятся id оставленных
+	// документов с разными наборами слов (больше одного — только при коллизии).
+	std::unordered_map<Fingerprint, std::vector<int>, FingerprintHasher> first_unique_documents;
+	first_unique_documents.reserve(document_ids.size());
+	std::vector<int> documents_to_remove;
+	std::vector<int> word_ids;
+	std::vector<int> unique_word_ids;
+	for (size_t i = 0; i < document_ids.size(); ++i)
 	{
-		std::set<std::string_view> words_in_document;
-		for (const auto& [word, _] : search_server.GetWordFrequencies(document_id))
+		std::vector<int>& unique_documents = first_unique_documents[fingerprints[i]];
+		bool is_duplicate = false;
+		if (!unique_documents.empty())
 		{
-			words_in_document.insert(word);
+			search_server.GetDocumentWordIds(document_ids[i], word_ids);
+			is_duplicate = std::any_of(unique_documents.begin(), unique_documents.end(), [&](int unique_document_id)
+				{
+					search_server.GetDocumentWordIds(unique_document_id, unique_word_ids);
+					return word_ids == unique_word_ids;
+				});
 		}
-		if (first_unique_documents.count(words_in_document) == 1)
+		if (is_duplicate)
 		{
-			documents_to_remove.push_back(document_id);
+			documents_to_remove.push_back(document_ids[i]);
 		}
 		else
 		{
-			first_unique_documents.insert(words_in_document);
+			unique_documents.push_back(document_ids[i]);
 		}
 	}
 
-	for (int document_id : documents_to_remove)
+	for (const int document_id : documents_to_remove)
 	{
 		std::cout << "Found duplicate document id " << document_id << std::endl;
-		search_server.RemoveDocument(document_id);
 	}
-}
\ No newline at end of file
+	search_server.RemoveDocuments(documents_to_remove);
+}
@@ -1,13 +1,46 @@
 #include "request_queue.h"
+#include <algorithm>
+#include <numeric>
 
-RequestQueue::RequestQueue(const SearchServer& search_server) : server_(search_server) {}
+namespace
+{
+	// Потоки получают копии корзин по очереди, в порядке первого запроса.
+	size_t GetThreadShardIndex(size_t shard_count)
+	{
+		static std::atomic<size_t> next_index{ 0 };
+		thread_local const size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+		return index % shard_count;
+	}
+}
+
+RequestQueue::Slot::Slot()
+	: period(-1)
+	, request_count(0)
+	, empty_count(0)
+	, result_count(0)
+{
+	for (auto& latency : latencies)
+	{
+		latency.store(0, std::memory_order_relaxed);
+	}
+}
+
+RequestQueue::RequestQueue(const SearchServer& search_server)
+	: server_(search_server)
+	, shards_(SHARD_COUNT)
+{
+	for (auto& is_empty : is_empty_results_)
+	{
+		is_empty.store(false, std::memory_order_relaxed);
+	}
+}
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status)
 {
-	return AddFindRequest(raw_query, [status](int document_id, DocumentStatus document_status, int rating)
-		{
-			return document_status == status;
-		});
+	const auto start = std::chrono::steady_clock::now();
+	auto result = server_.FindTopDocuments(raw_query, status);
+	RecordRequest(result.size(), std::chrono::steady_clock::now() - start);
+	return result;
 }
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query)
@@ -15,7 +48,170 @@ std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query)
 	return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
 }
 
+void RequestQueue::RecordRequest(size_t result_count, std::chrono::nanoseconds latency, Clock::time_point time)
+{
+	// Окно последних запросов: флаг запроса заменяет флаг запроса, сделанного
+	// min_in_day_ запросов назад.
+	const uint64_t request_index = request_count_.fetch_add(1, std::memory_order_relaxed);
+	is_empty_results_[request_index % min_in_day_].store(result_count == 0, std::memory_order_relaxed);
+
+	Shard& shard = shards_[GetThreadShardIndex(SHARD_COUNT)];
+	const int64_t minute = std::chrono::duration_cast<std::chrono::minutes>(time.time_since_epoch()).count();
+	const size_t latency_bucket = GetLatencyBucket(
+		static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(latency).count())));
+	RecordToSlot(shard.minute_slots[minute % MINUTE_SLOT_COUNT], minute, result_count, latency_bucket);
+	const int64_t hour = minute / 60;
+	RecordToSlot(shard.hour_slots[hour % HOUR_SLOT_COUNT], hour, result_count, latency_bucket);
+}
+
 int RequestQueue::GetNoResultRequests() const
 {
-	return empty_results_count_;
-}
\ No newline at end of file
+	// Флаги считаются при запросе статистики, чтобы запись обходилась без общего счётчика.
+	return static_cast<int>(std::count_if(is_empty_results_.begin(), is_empty_results_.end(), [](const std::atomic<bool>& is_empty)
+		{
+			return is_empty.load(std::memory_order_relaxed);
+		}));
+}
+
+RequestQueue::Stats RequestQueue::GetStats(Window window, Clock::time_point now) const
+{
+	const int64_t minute = std::chrono::duration_cast<std::chrono::minutes>(now.time_since_epoch()).count();
+	bool is_hour_slots = false;
+	size_t slot_count = MINUTE_SLOT_COUNT;
+	int64_t last_period = minute;
+	int64_t period_count = 1;
+	switch (window)
+	{
+	case Window::MINUTE:
+		break;
+	case Window::HOUR:
+		period_count = MINUTE_SLOT_COUNT;
+		break;
+	case Window::DAY:
+		is_hour_slots = true;
+		slot_count = HOUR_SLOT_COUNT;
+		last_period = minute / 60;
+		period_count = HOUR_SLOT_COUNT;
+		break;
+	}
+
+	Stats stats;
+	std::array<uint64_t, LATENCY_BUCKET_COUNT> latencies{};
+	for (const Shard& shard : shards_)
+	{
+		const Slot* first_slot = is_hour_slots ? shard.hour_slots.data() : shard.minute_slots.data();
+		for (size_t i = 0; i < slot_count; ++i)
+		{
+			const Slot& slot = first_slot[i];
+			const int64_t period = slot.period.load(std::memory_order_acquire);
+			if (period > last_period || period <= last_period - period_count)
+			{
+				continue;
+			}
+			stats.request_count += slot.request_count.load(std::memory_order_relaxed);
+			stats.empty_count += slot.empty_count.load(std::memory_order_relaxed);
+			stats.result_count += slot.result_count.load(std::memory_order_relaxed);
+			for (size_t bucket = 0; bucket < LATENCY_BUCKET_COUNT; ++bucket)
+			{
+				latencies[bucket] += slot.latencies[bucket].load(std::memory_order_relaxed);
+			}
+		}
+	}
+	if (stats.request_count == 0)
+	{
+		return stats;
+	}
+	stats.empty_rate = static_cast<double>(stats.empty_count) / static_cast<double>(stats.request_count);
+
+	// Перцентиль — верхняя граница интервала гистограммы, в котором он лежит.
+	const uint64_t latency_count = std::accumulate(latencies.begin(), latencies.end(), uint64_t(0));
+	const auto get_percentile = [&latencies, latency_count](double fraction)
+		{
+			const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * static_cast<double>(latency_count) + 0.5));
+			uint64_t count = 0;
+			for (size_t bucket = 0; bucket < LATENCY_BUCKET_COUNT; ++bucket)
+			{
+				count += latencies[bucket];
+				if (count >= rank)
+				{
+					return std::chrono::microseconds(GetLatencyBucketUpperBound(bucket));
+				}
+			}
+			return std::chrono::microseconds(GetLatencyBucketUpperBound(LATENCY_BUCKET_COUNT - 1));
+		};
+	stats.latency_p50 = get_percentile(0.5);
+	stats.latency_p90 = get_percentile(0.9);
+	stats.latency_p99 = get_percentile(0.99);
+	return stats;
+}
+
+size_t RequestQueue::GetLatencyBucket(uint64_t microseconds)
+{
+	if (microseconds < EXACT_LATENCY_BUCKET_COUNT)
+	{
+		return static_cast<size_t>(microseconds);
+	}
+	size_t exponent = 0;
+	while ((microseconds >> (exponent + 1)) != 0)
+	{
+		++exponent;
+	}
+	const size_t sub_bucket = (microseconds >> (exponent - LATENCY_SUB_BUCKET_BITS)) & ((1u << LATENCY_SUB_BUCKET_BITS) - 1);
+	const size_t bucket = EXACT_LATENCY_BUCKET_COUNT + ((exponent - 4) << LATENCY_SUB_BUCKET_BITS) + sub_bucket;
+	return std::min(bucket, LATENCY_BUCKET_COUNT - 1);
+}
+
+uint64_t RequestQueue::GetLatencyBucketUpperBound(size_t bucket)
+{
+	if (bucket < EXACT_LATENCY_BUCKET_COUNT)
+	{
+		return bucket;
+	}
+	const size_t exponent = 4 + ((bucket - EXACT_LATENCY_BUCKET_COUNT) >> LATENCY_SUB_BUCKET_BITS);
+	const uint64_t sub_bucket = (bucket - EXACT_LATENCY_BUCKET_COUNT) & ((1u << LATENCY_SUB_BUCKET_BITS) - 1);
+	const uint64_t width = uint64_t(1) << (exponent - LATENCY_SUB_BUCKET_BITS);
+	return (((uint64_t(1) << LATENCY_SUB_BUCKET_BITS) + sub_bucket) * width) + width - 1;
+}
+
+void RequestQueue::RecordToSlot(Slot& slot, int64_t period, size_t result_count, size_t latency_bucket)
+{
+	// Первый запрос нового периода забирает корзину и очищает её.
+	int64_t slot_period = slot.period.load(std::memory_order_acquire);
+	while (slot_period < period)
+	{
+		if (slot.period.compare_exchange_weak(slot_period, period, std::memory_order_acq_rel))
+		{
+			slot.request_count.store(0, std::memory_order_relaxed);
+			slot.empty_count.store(0, std::memory_order_relaxed);
+			slot.result_count.store(0, std::memory_order_relaxed);
+			for (auto& latency : slot.latencies)
+			{
+				latency.store(0, std::memory_order_relaxed);
+			}
+			slot_period = period;
+		}
+	}
+	// Запрос из уже ушедшего периода (часы сдвинулись назад или поток задержался) не учитывается.
+	if (slot_period != period)
+	{
+		return;
+	}
+	slot.request_count.fetch_add(1, std::memory_order_relaxed);
+	if (result_count == 0)
+	{
+		slot.empty_count.fetch_add(1, std::memory_order_relaxed);
+	}
+	slot.result_count.fetch_add(result_count, std::memory_order_relaxed);
+	slot.latencies[latency_bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::ostream& operator<<(std::ostream& os, const RequestQueue::Stats& stats)
+{
+	return os << "{ requests = " << stats.request_count
+		<< ", empty = " << stats.empty_count
+		<< ", results = " << stats.result_count
+		<< ", empty_rate = " << stats.empty_rate
+		<< ", p50 = " << stats.latency_p50.count() << "us"
+		<< ", p90 = " << stats.latency_p90.count() << "us"
+		<< ", p99 = " << stats.latency_p99.count() << "us }";
+}
@@ -1,14 +1,52 @@
 #pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
 #include <vector>
-#include <deque>
 #include <string>
 #include "search_server.h"
 #include "document.h"
 
+// Статистика запросов к поисковому серверу. Потокобезопасна и не использует
+// блокировок: запрос учитывается несколькими атомарными сложениями.
+//
+// Общим для всех потоков остаётся только номер запроса в окне последних запросов.
+// Корзины разнесены по SHARD_COUNT независимым копиям, поток пишет в свою, и
+// GetStats складывает копии, поэтому параллельные запросы не делят строки кеша.
+//
+// Запросы складываются в корзины по минутам (последние 60) и по часам (последние 24)
+// реального времени. В каждой корзине — число запросов, пустых ответов, найденных
+// документов и гистограмма задержек с логарифмическими интервалами (погрешность
+// перцентиля не больше 1/8). Корзина переиспользуется, когда наступает её новый
+// период; отсчёты, попавшие в корзину в момент её очистки, могут потеряться.
 class RequestQueue
 {
 public:
 
+	using Clock = std::chrono::system_clock;
+
+	// Текущая минута, последние 60 минут или последние 24 часа, включая текущий час.
+	enum class Window
+	{
+		MINUTE,
+		HOUR,
+		DAY
+	};
+
+	struct Stats
+	{
+		uint64_t request_count = 0;
+		uint64_t empty_count = 0;
+		uint64_t result_count = 0;
+		double empty_rate = 0.0;
+		std::chrono::microseconds latency_p50{ 0 };
+		std::chrono::microseconds latency_p90{ 0 };
+		std::chrono::microseconds latency_p99{ 0 };
+	};
+
 	explicit RequestQueue(const SearchServer& search_server);
 
 	template <typename DocumentPredicate>
@@ -18,38 +56,65 @@ public:
 
 	std::vector<Document> AddFindRequest(const std::string& raw_query);
 
+	// Учитывает запрос, выполненный в обход очереди, например в ProcessQueries.
+	void RecordRequest(size_t result_count, std::chrono::nanoseconds latency, Clock::time_point time = Clock::now());
+
+	// Число пустых ответов среди последних 1440 запросов.
 	int GetNoResultRequests() const;
 
+	Stats GetStats(Window window, Clock::time_point now = Clock::now()) const;
+
 private:
 
-	struct QueryResult
+	static const int min_in_day_ = 1440;
+	static const size_t MINUTE_SLOT_COUNT = 60;
+	static const size_t HOUR_SLOT_COUNT = 24;
+	// Задержки до 16 мкс считаются точно, дальше по 8 интервалов на каждую степень двойки.
+	static const size_t EXACT_LATENCY_BUCKET_COUNT = 16;
+	static const size_t LATENCY_SUB_BUCKET_BITS = 3;
+	static const size_t LATENCY_BUCKET_COUNT = 240;
+	static const size_t SHARD_COUNT = 8;
+
+	struct alignas(64) Slot
+	{
+		Slot();
+
+		// Номер минуты или часа от начала эпохи, к которому относится корзина.
+		std::atomic<int64_t> period;
+		std::atomic<uint64_t> request_count;
+		std::atomic<uint64_t> empty_count;
+		std::atomic<uint64_t> result_count;
+		std::array<std::atomic<uint32_t>, LATENCY_BUCKET_COUNT> latencies;
+	};
+
+	struct Shard
 	{
-		bool is_empty;
+		std::array<Slot, MINUTE_SLOT_COUNT> minute_slots;
+		std::array<Slot, HOUR_SLOT_COUNT> hour_slots;
 	};
 
-	std::deque<QueryResult> requests_;
-	const static int min_in_day_ = 1440;
-	int empty_results_count_ = 0;
+	static size_t GetLatencyBucket(uint64_t microseconds);
+
+	static uint64_t GetLatencyBucketUpperBound(size_t bucket);
+
+	static void RecordToSlot(Slot& slot, int64_t period, size_t result_count, size_t latency_bucket);
+
 	const SearchServer& server_;
+
+	std::array<std::atomic<bool>, min_in_day_> is_empty_results_;
+	std::atomic<uint64_t> request_count_{ 0 };
+
+	std::vector<Shard> shards_;
 };
 
+std::ostream& operator<<(std::ostream& os, const RequestQueue::Stats& stats);
+
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate)
 {
-	const auto result = server_.FindTopDocuments(raw_query, document_predicate);
-	requests_.push_back({ result.empty() });
-	if (result.empty())
-	{
-		++empty_results_count_;
-	}
-	if (requests_.size() > min_in_day_)
-	{
-		if (requests_.front().is_empty)
-		{
-			--empty_results_count_;
-		}
-		requests_.pop_front();
-	}
+	const auto start = std::chrono::steady_clock::now();
+	auto result = server_.FindTopDocuments(raw_query, document_predicate);
+	RecordRequest(result.size(), std::chrono::steady_clock::now() - start);
 	return result;
-}
\ No newline at end of file
+}
@@ -1,6 +1,8 @@
 #include "search_server.h"
 #include <cmath>
 #include <algorithm>
+#include <cstdio>
+#include <fstream>
 
 SearchServer::SearchServer() = default;
 
@@ -15,50 +17,389 @@ SearchServer::SearchServer(const std::string_view stop_words_text)
 		throw std::invalid_argument("stop words contain invalid characters");
 	}
 	for (auto word : SplitIntoWords(stop_words_text)) {
-		stop_words_.insert(std::string(word));
+		stop_words_.Intern(word);
 	}
 }
 
 void SearchServer::SetStopWords(const std::string& text)
 {
+	++index_version_;
 	for (const std::string_view word : SplitIntoWords(std::string_view(text)))
 	{
-		stop_words_.insert(word.data());
+		stop_words_.Intern(word);
 	}
 }
 
 void SearchServer::AddDocument(int document_id, std::string_view document,
 	DocumentStatus status, const std::vector<int>& ratings)
 {
-	if (documents_.count(document_id) == 1 || document_id < 0)
+	if (document_id_to_ordinal_.count(document_id) == 1 || document_id < 0)
 	{
 		throw std::invalid_argument("Document with this id already exists or id less then 0");
 	}
 
-	const std::vector<std::string_view> words = SplitIntoWordsNoStop(document);
-
-	if (!std::all_of(words.begin(), words.end(), [this](const auto word)
-		{
-			return IsValidWord(word);
-		}))
+	std::vector<std::string_view>& words = GetThreadLocalWordBuffer();
+	if (!SplitIntoWordsNoStop(document, words))
 	{
 		throw std::invalid_argument("One or more words contain a special symbol");
 	}
+	++index_version_;
+
+	int ordinal;
+	if (free_ordinals_.empty())
+	{
+		ordinal = static_cast<int>(documents_.size());
+		documents_.Resize(documents_.size() + 1);
+		document_to_word_freqs_.emplace_back();
+	}
+	else
+	{
+		ordinal = free_ordinals_.back();
+		free_ordinals_.pop_back();
+	}
 
 	const double inv_word_count = 1.0 / words.size();
-	for (const auto word : words)
+	std::vector<int> word_ids(words.size());
+	std::transform(words.begin(), words.end(), word_ids.begin(), [this](const std::string_view word)
+		{
+			return InternWord(word);
+		});
+	std::sort(word_ids.begin(), word_ids.end());
+
+	auto& word_freqs = document_to_word_freqs_[ordinal];
+	for (auto it = word_ids.begin(); it != word_ids.end();)
 	{
-		auto it = all_words_.emplace(std::string(word));
-		word_to_document_freqs_[*(it.first)][document_id] += inv_word_count;
-		document_to_word_freqs_[document_id][*(it.first)] += inv_word_count;
+		const int word_id = *it;
+		const auto next = std::upper_bound(it, word_ids.end(), word_id);
+		const int term_count = static_cast<int>(next - it);
+		const double term_freq = term_count * inv_word_count;
+		word_freqs.emplace(words_.Get(word_id), term_freq);
+		word_postings_[word_id].Add(ordinal, term_count, term_freq);
+		UpdateWordDocumentFreq(word_id);
+		it = next;
 	}
-	documents_.emplace(document_id, DocumentInfo{ ComputeAverageRating(ratings), status });
+	documents_.Set(ordinal, document_id, ComputeAverageRating(ratings), status, inv_word_count);
+	document_id_to_ordinal_.emplace(document_id, ordinal);
 	document_ids_.insert(document_id);
+	UpdateDocumentCount();
+}
+
+void SearchServer::AddDocuments(const std::vector<NewDocument>& documents)
+{
+	AddDocumentsImpl(std::execution::par, documents);
+}
+
+void SearchServer::AddDocuments(const std::execution::sequenced_policy&, const std::vector<NewDocument>& documents)
+{
+	AddDocumentsImpl(std::execution::seq, documents);
+}
+
+void SearchServer::AddDocuments(const std::execution::parallel_policy&, const std::vector<NewDocument>& documents)
+{
+	AddDocumentsImpl(std::execution::par, documents);
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::AddDocumentsImpl(ExecutionPolicy&& policy, const std::vector<NewDocument>& documents)
+{
+	// Разбор текстов не меняет состояние сервера, поэтому документы обрабатываются независимо.
+	// Слова документа сортируются и сворачиваются в пары (слово, число вхождений).
+	struct ParsedDocument
+	{
+		std::vector<std::pair<std::string_view, int>> word_counts;
+		size_t word_count = 0;
+		bool has_invalid_word = false;
+	};
+
+	std::vector<ParsedDocument> parsed_documents(documents.size());
+	++index_version_;
+	std::vector<size_t> indexes(documents.size());
+	std::iota(indexes.begin(), indexes.end(), 0);
+	std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t index)
+		{
+			ParsedDocument& parsed = parsed_documents[index];
+			std::vector<std::string_view>& words = GetThreadLocalWordBuffer();
+			if (!SplitIntoWordsNoStop(documents[index].document, words))
+			{
+				parsed.has_invalid_word = true;
+				return;
+			}
+			parsed.word_count = words.size();
+			std::sort(words.begin(), words.end());
+			for (const std::string_view word : words)
+			{
+				if (parsed.word_counts.empty() || parsed.word_counts.back().first != word)
+				{
+					parsed.word_counts.push_back({ word, 0 });
+				}
+				++parsed.word_counts.back().second;
+			}
+		});
+
+	// Проверки выполняются в порядке следования документов, как при последовательных вызовах.
+	size_t accepted_count = 0;
+	const char* error = nullptr;
+	std::unordered_map<int, size_t> batch_ids;
+	for (; accepted_count < documents.size(); ++accepted_count)
+	{
+		const int document_id = documents[accepted_count].document_id;
+		if (document_id_to_ordinal_.count(document_id) == 1 || document_id < 0
+			|| !batch_ids.emplace(document_id, accepted_count).second)
+		{
+			error = "Document with this id already exists or id less then 0";
+			break;
+		}
+		if (parsed_documents[accepted_count].has_invalid_word)
+		{
+			error = "One or more words contain a special symbol";
+			break;
+		}
+	}
+
+	std::vector<int> ordinals(accepted_count);
+	for (size_t index = 0; index < accepted_count; ++index)
+	{
+		int ordinal;
+		if (free_ordinals_.empty())
+		{
+			ordinal = static_cast<int>(documents_.size());
+			documents_.Resize(documents_.size() + 1);
+			document_to_word_freqs_.emplace_back();
+		}
+		else
+		{
+			ordinal = free_ordinals_.back();
+			free_ordinals_.pop_back();
+		}
+		ordinals[index] = ordinal;
+
+		const NewDocument& document = documents[index];
+		documents_.Set(ordinal, document.document_id, ComputeAverageRating(document.ratings), document.status,
+			1.0 / parsed_documents[index].word_count);
+		document_id_to_ordinal_.emplace(document.document_id, ordinal);
+		document_ids_.insert(document.document_id);
+	}
+
+	std::vector<size_t> offsets(accepted_count + 1, 0);
+	for (size_t index = 0; index < accepted_count; ++index)
+	{
+		offsets[index + 1] = offsets[index] + parsed_documents[index].word_counts.size();
+	}
+
+	// Номера известных слов ищутся параллельно, новые слова вносятся в словарь
+	// последовательно. Дальше словарь не меняется, и разные документы и списки
+	// вхождений заполняются параллельно.
+	std::vector<int> posting_words(offsets.back());
+	std::for_each(policy, indexes.begin(), indexes.begin() + accepted_count, [&](size_t index)
+		{
+			size_t position = offsets[index];
+			for (const auto& [word, _] : parsed_documents[index].word_counts)
+			{
+				posting_words[position++] = words_.Find(word);
+			}
+		});
+	for (size_t index = 0; index < accepted_count; ++index)
+	{
+		size_t position = offsets[index];
+		for (const auto& [word, _] : parsed_documents[index].word_counts)
+		{
+			if (posting_words[position] == StringInterner::NOT_FOUND)
+			{
+				posting_words[position] = InternWord(word);
+			}
+			++position;
+		}
+	}
+
+	struct NewPosting
+	{
+		int ordinal;
+		int term_count;
+		double term_freq;
+	};
+
+	// Частичные индексы документов: вхождения в порядке слов документа.
+	std::vector<NewPosting> document_postings(offsets.back());
+	std::for_each(policy, indexes.begin(), indexes.begin() + accepted_count, [&](size_t index)
+		{
+			const int ordinal = ordinals[index];
+			const double inv_word_count = documents_.inv_word_counts[ordinal];
+			auto& word_freqs = document_to_word_freqs_[ordinal];
+			size_t position = offsets[index];
+			for (const auto& [_, term_count] : parsed_documents[index].word_counts)
+			{
+				const double term_freq = term_count * inv_word_count;
+				word_freqs.emplace_hint(word_freqs.end(), words_.Get(posting_words[position]), term_freq);
+				document_postings[position++] = { ordinal, term_count, term_freq };
+			}
+		});
+
+	// Слияние: вхождения раскладываются по словам сортировкой подсчётом,
+	// затем каждый список вхождений пополняется независимо от остальных.
+	std::vector<size_t> word_offsets(words_.GetIdBound() + 1, 0);
+	for (const int word_id : posting_words)
+	{
+		++word_offsets[word_id + 1];
+	}
+	std::partial_sum(word_offsets.begin(), word_offsets.end(), word_offsets.begin());
+	std::vector<NewPosting> new_postings(document_postings.size());
+	{
+		std::vector<size_t> positions(word_offsets.begin(), word_offsets.end() - 1);
+		for (size_t i = 0; i < document_postings.size(); ++i)
+		{
+			new_postings[positions[posting_words[i]]++] = document_postings[i];
+		}
+	}
+
+	std::vector<int> batch_word_ids;
+	for (size_t word_id = 0; word_id + 1 < word_offsets.size(); ++word_id)
+	{
+		if (word_offsets[word_id] != word_offsets[word_id + 1])
+		{
+			batch_word_ids.push_back(static_cast<int>(word_id));
+		}
+	}
+	std::for_each(policy, batch_word_ids.begin(), batch_word_ids.end(), [&](int word_id)
+		{
+			const auto first = new_postings.begin() + word_offsets[word_id];
+			const auto last = new_postings.begin() + word_offsets[word_id + 1];
+			// Номера идут по возрастанию, если не переиспользовались номера удалённых документов.
+			const auto ordinal_less = [](const NewPosting& lhs, const NewPosting& rhs)
+				{
+					return lhs.ordinal < rhs.ordinal;
+				};
+			if (!std::is_sorted(first, last, ordinal_less))
+			{
+				std::sort(first, last, ordinal_less);
+			}
+			PostingList& postings = word_postings_[word_id];
+			for (auto it = first; it != last; ++it)
+			{
+				postings.Add(it->ordinal, it->term_count, it->term_freq);
+			}
+			UpdateWordDocumentFreq(word_id);
+		});
+	UpdateDocumentCount();
+
+	if (error != nullptr)
+	{
+		throw std::invalid_argument(error);
+	}
+}
+
+size_t SearchServer::DocumentColumns::size() const
+{
+	return ids.size();
+}
+
+void SearchServer::DocumentColumns::Resize(size_t size)
+{
+	ids.resize(size, -1);
+	ratings.resize(size, 0);
+	statuses.resize(size, DocumentStatus::REMOVED);
+	inv_word_counts.resize(size, 0.0);
+}
+
+void SearchServer::DocumentColumns::Set(int ordinal, int id, int rating, DocumentStatus status, double inv_word_count)
+{
+	ids[ordinal] = id;
+	ratings[ordinal] = rating;
+	statuses[ordinal] = status;
+	inv_word_counts[ordinal] = inv_word_count;
+}
+
+size_t SearchServer::DocumentColumns::GetMemoryUsage() const
+{
+	return ids.capacity() * sizeof(int)
+		+ ratings.capacity() * sizeof(int)
+		+ statuses.capacity() * sizeof(DocumentStatus)
+		+ inv_word_counts.capacity() * sizeof(double);
 }
 
 int SearchServer::GetDocumentCount() const
 {
-	return static_cast<int>(documents_.size());
+	return static_cast<int>(document_id_to_ordinal_.size());
+}
+
+void SearchServer::SetPostingsCompression(bool enabled)
+{
+	compress_postings_ = enabled;
+	for (PostingList& postings : word_postings_)
+	{
+		postings.SetCompressed(enabled);
+	}
+}
+
+bool SearchServer::IsPostingsCompressionEnabled() const
+{
+	return compress_postings_;
+}
+
+namespace
+{
+	// Оценка накладных расходов узловых контейнеров стандартной библиотеки:
+	// служебные указатели узла дерева и узла хеш-таблицы с закешированным хешем.
+	const size_t TREE_NODE_OVERHEAD = 4 * sizeof(void*);
+	const size_t HASH_NODE_OVERHEAD = 2 * sizeof(void*);
+}
+
+SearchServer::MemoryUsage SearchServer::GetMemoryUsage() const
+{
+	MemoryUsage usage;
+
+	usage.documents = documents_.GetMemoryUsage()
+		+ free_ordinals_.capacity() * sizeof(int)
+		+ document_id_to_ordinal_.bucket_count() * sizeof(void*)
+		+ document_id_to_ordinal_.size() * (HASH_NODE_OVERHEAD + sizeof(std::pair<const int, int>))
+		+ document_ids_.size() * (TREE_NODE_OVERHEAD + sizeof(int));
+
+	usage.forward_index = document_to_word_freqs_.capacity() * sizeof(std::map<std::string_view, double>);
+	for (const auto& word_freqs : document_to_word_freqs_)
+	{
+		usage.forward_index += word_freqs.size() * (TREE_NODE_OVERHEAD + sizeof(std::pair<const std::string_view, double>));
+	}
+
+	usage.term_dictionary = word_postings_.capacity() * sizeof(PostingList)
+		+ word_log_document_freqs_.capacity() * sizeof(double);
+	for (const PostingList& postings : word_postings_)
+	{
+		usage.postings += postings.GetMemoryUsage() - sizeof(PostingList);
+	}
+
+	usage.words = words_.GetMemoryUsage() + stop_words_.GetMemoryUsage();
+
+	return usage;
+}
+
+size_t SearchServer::MemoryUsage::GetTotal() const
+{
+	return documents + forward_index + term_dictionary + postings + words;
+}
+
+std::ostream& operator<<(std::ostream& os, const SearchServer::MemoryUsage& usage)
+{
+	return os << "{ documents = " << usage.documents
+		<< ", forward_index = " << usage.forward_index
+		<< ", term_dictionary = " << usage.term_dictionary
+		<< ", postings = " << usage.postings
+		<< ", words = " << usage.words
+		<< ", total = " << usage.GetTotal() << " }";
+}
+
+int SearchServer::FindOrdinal(int document_id) const
+{
+	const auto it = document_id_to_ordinal_.find(document_id);
+	return it == document_id_to_ordinal_.end() ? -1 : it->second;
+}
+
+int SearchServer::GetOrdinal(int document_id) const
+{
+	const int ordinal = FindOrdinal(document_id);
+	if (ordinal < 0)
+	{
+		throw std::out_of_range("the document id does not exist");
+	}
+	return ordinal;
 }
 
 std::set<int>::const_iterator SearchServer::begin() const
@@ -83,44 +424,331 @@ std::set<int>::iterator SearchServer::end()
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query) const
 {
-	return FindTopDocuments(raw_query, [](const int document_id, DocumentStatus status, int rating)
+	return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::vector<std::string>& raw_queries) const
+{
+	return FindTopDocumentsBatch(raw_queries, DocumentStatus::ACTUAL, MAX_RESULT_DOCUMENT_COUNT);
+}
+
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+	DocumentStatus status, size_t max_result_count) const
+{
+	PROFILE_SCOPE("search.batch");
+	// Запросы разбираются последовательно, чтобы ошибка разбора дошла до вызывающего.
+	// Одинаковые после нормализации запросы схлопываются.
+	std::vector<BatchQuery> queries;
+	std::vector<size_t> query_indexes(raw_queries.size());
+	{
+		std::unordered_map<std::string, size_t> query_by_key;
+		Query query;
+		QueryCache::Key key;
+		for (size_t i = 0; i < raw_queries.size(); ++i)
+		{
+			ParseQuery(raw_queries[i], query, true);
+			MakeQueryCacheKey(query, status, max_result_count, key);
+			const auto [it, is_new] = query_by_key.emplace(key.words, queries.size());
+			query_indexes[i] = it->second;
+			if (!is_new)
+			{
+				continue;
+			}
+			BatchQuery& batch_query = queries.emplace_back();
+			for (const std::string_view word : query.plus_words)
+			{
+				const int word_id = words_.Find(word);
+				if (word_id != StringInterner::NOT_FOUND)
+				{
+					batch_query.plus_word_ids.push_back(word_id);
+				}
+			}
+			for (const std::string_view word : query.minus_words)
+			{
+				const int word_id = words_.Find(word);
+				if (word_id != StringInterner::NOT_FOUND)
+				{
+					batch_query.minus_word_ids.push_back(word_id);
+				}
+			}
+		}
+	}
+
+	// Запросы делятся на группы по числу потоков: чем крупнее группа, тем больше
+	// общих слов обходится однократно.
+	const size_t min_group_size = 64;
+	const size_t group_count = std::max<size_t>(1, std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()),
+		(queries.size() + min_group_size - 1) / min_group_size));
+	const size_t group_size = (queries.size() + group_count - 1) / group_count;
+	std::vector<size_t> groups(group_count);
+	std::iota(groups.begin(), groups.end(), 0);
+
+	std::vector<std::vector<Document>> results(queries.size());
+	std::for_each(std::execution::par, groups.begin(), groups.end(), [&](size_t group)
+		{
+			const size_t first_query = std::min(queries.size(), group * group_size);
+			const size_t last_query = std::min(queries.size(), first_query + group_size);
+			FindBatchGroupDocuments(queries, first_query, last_query, status, max_result_count, results);
+		});
+
+	std::vector<std::vector<Document>> documents(raw_queries.size());
+	for (size_t i = 0; i < raw_queries.size(); ++i)
+	{
+		documents[i] = results[query_indexes[i]];
+	}
+	return documents;
+}
+
+void SearchServer::FindBatchGroupDocuments(const std::vector<BatchQuery>& queries, size_t first_query, size_t last_query,
+	DocumentStatus status, size_t max_result_count, std::vector<std::vector<Document>>& results) const
+{
+	if (first_query == last_query)
+	{
+		return;
+	}
+
+	// Слова группы: каждый список вхождений читается одним курсором по окнам номеров.
+	// В окно попадают только документы с нужным статусом вместе с их вкладом tf * idf.
+	std::vector<int> word_ids;
+	for (size_t query = first_query; query < last_query; ++query)
+	{
+		word_ids.insert(word_ids.end(), queries[query].plus_word_ids.begin(), queries[query].plus_word_ids.end());
+		word_ids.insert(word_ids.end(), queries[query].minus_word_ids.begin(), queries[query].minus_word_ids.end());
+	}
+	std::sort(word_ids.begin(), word_ids.end());
+	word_ids.erase(std::unique(word_ids.begin(), word_ids.end()), word_ids.end());
+	const auto get_term_index = [&word_ids](int word_id)
+		{
+			return static_cast<size_t>(std::lower_bound(word_ids.begin(), word_ids.end(), word_id) - word_ids.begin());
+		};
+
+	struct GroupTerm
+	{
+		PostingList::Cursor cursor;
+		double inverse_document_freq;
+		std::vector<std::pair<int, double>> window_postings;
+	};
+	std::vector<GroupTerm> terms;
+	terms.reserve(word_ids.size());
+	for (const int word_id : word_ids)
+	{
+		terms.push_back({ PostingList::Cursor(word_postings_[word_id]), GetWordInverseDocumentFreq(word_id), {} });
+	}
+
+	std::vector<std::vector<size_t>> plus_terms(last_query - first_query);
+	std::vector<std::vector<size_t>> minus_terms(last_query - first_query);
+	for (size_t query = first_query; query < last_query; ++query)
+	{
+		for (const int word_id : queries[query].plus_word_ids)
+		{
+			plus_terms[query - first_query].push_back(get_term_index(word_id));
+		}
+		for (const int word_id : queries[query].minus_word_ids)
+		{
+			minus_terms[query - first_query].push_back(get_term_index(word_id));
+		}
+	}
+
+	const int window_size = 8192;
+	const int ordinal_count = static_cast<int>(documents_.size());
+	std::vector<TopDocuments> top_documents(last_query - first_query, TopDocuments(max_result_count));
+	RelevanceAccumulator accumulator;
+	OrdinalBitmap excluded;
+
+	for (int first = 0; first < ordinal_count; first += window_size)
+	{
+		const int last = std::min(ordinal_count, first + window_size);
+		{
+			PROFILE_SCOPE("search.traverse");
+			for (GroupTerm& term : terms)
+			{
+				term.window_postings.clear();
+				for (; term.cursor.IsValid() && term.cursor.Get().ordinal < last; term.cursor.Next())
+				{
+					const auto [ordinal, term_count] = term.cursor.Get();
+					if (documents_.statuses[ordinal] == status)
+					{
+						term.window_postings.push_back({ ordinal, term_count * documents_.inv_word_counts[ordinal] * term.inverse_document_freq });
+					}
+				}
+			}
+		}
+
+		// Вклады слов суммируются в порядке плюс-слов запроса, как при обычном поиске.
+		for (size_t query = 0; query < plus_terms.size(); ++query)
+		{
+			{
+				PROFILE_SCOPE("search.accumulate");
+				accumulator.Reset(last - first);
+				for (const size_t term_index : plus_terms[query])
+				{
+					for (const auto& [ordinal, contribution] : terms[term_index].window_postings)
+					{
+						accumulator.Add(ordinal - first, contribution);
+					}
+				}
+			}
+			if (accumulator.GetTouched().empty())
+			{
+				continue;
+			}
+
+			{
+				PROFILE_SCOPE("search.filter");
+				excluded.Reset(last - first);
+				for (const size_t term_index : minus_terms[query])
+				{
+					for (const auto& [ordinal, _] : terms[term_index].window_postings)
+					{
+						excluded.Insert(ordinal - first);
+					}
+				}
+			}
+			PROFILE_SCOPE("search.chunk_top_k");
+			for (const int local_ordinal : accumulator.GetTouched())
+			{
+				if (!excluded.Contains(local_ordinal))
+				{
+					const int ordinal = first + local_ordinal;
+					top_documents[query].Push({ documents_.ids[ordinal], accumulator.GetRelevance(local_ordinal), documents_.ratings[ordinal] });
+				}
+			}
+		}
+	}
+
+	for (size_t query = first_query; query < last_query; ++query)
+	{
+		results[query] = top_documents[query - first_query].Extract();
+	}
+}
+
+const std::vector<Document>& SearchServer::FindTopDocuments(QueryContext& context, const std::string_view raw_query) const
+{
+	return FindTopDocuments(context, raw_query, DocumentStatus::ACTUAL);
+}
+
+void SearchServer::EnableQueryCache(size_t capacity)
+{
+	query_cache_ = std::make_unique<QueryCache>(capacity);
+}
+
+void SearchServer::DisableQueryCache()
+{
+	query_cache_.reset();
+}
+
+QueryCache::Stats SearchServer::GetQueryCacheStats() const
+{
+	return query_cache_ ? query_cache_->GetStats() : QueryCache::Stats();
+}
+
+uint64_t SearchServer::GetIndexVersion() const
+{
+	return index_version_;
+}
+
+void SearchServer::MakeQueryCacheKey(const Query& query, DocumentStatus status, size_t max_result_count, QueryCache::Key& key)
+{
+	key.words.clear();
+	key.status = status;
+	key.max_result_count = max_result_count;
+	for (const std::string_view word : query.plus_words)
+	{
+		key.words.append(word).push_back(' ');
+	}
+	for (const std::string_view word : query.minus_words)
+	{
+		key.words.append(1, '-').append(word).push_back(' ');
+	}
+}
+
+SearchServer::FilterPredicate SearchServer::MakeDocumentPredicate(const DocumentFilter& filter, const Query& query,
+	std::vector<uint64_t>& filter_bits) const
+{
+	const size_t posting_count = CountPlusWordPostings(query);
+	// Вычисление по столбцам обходит все документы, но в разы дешевле построчной
+	// проверки, поэтому окупается, когда запрос затрагивает хотя бы их четверть.
+	if (posting_count * 4 < documents_.size())
+	{
+		return { &filter, nullptr, &documents_ };
+	}
+	PROFILE_SCOPE("search.filter");
+	filter.Evaluate(documents_.ids.data(), documents_.statuses.data(), documents_.ratings.data(), documents_.size(), filter_bits);
+	return { &filter, filter_bits.data(), &documents_ };
+}
+
+size_t SearchServer::CountPlusWordPostings(const Query& query) const
+{
+	size_t posting_count = 0;
+	for (const auto& word : query.plus_words)
+	{
+		if (const PostingList* postings = FindPostings(word))
+		{
+			posting_count += postings->size();
+		}
+	}
+	return posting_count;
+}
+
+void SearchServer::FillExcludedDocuments(const Query& query, OrdinalBitmap& excluded) const
+{
+	PROFILE_SCOPE("search.filter");
+	excluded.Reset(documents_.size());
+	std::array<Posting, PostingList::MAX_BLOCK_SIZE> cursor_buffer;
+	for (const auto& word : query.minus_words)
+	{
+		if (const PostingList* postings = FindPostings(word))
 		{
-			return status == DocumentStatus::ACTUAL;
+			for (PostingList::Cursor cursor(*postings, cursor_buffer.data()); cursor.IsValid(); cursor.Next())
+			{
+				excluded.Insert(cursor.Get().ordinal);
+			}
+		}
+	}
+}
+
+bool SearchServer::HasMinusWord(int ordinal, const Query& query) const
+{
+	// Минус-слов в запросе обычно единицы, поэтому параллельная проверка
+	// обходится дороже поиска в прямом индексе документа.
+	return std::any_of(query.minus_words.begin(), query.minus_words.end(), [this, ordinal](const std::string_view word)
+		{
+			return DocumentContainsWord(ordinal, word);
 		});
 }
 
+bool SearchServer::FindCachedDocuments(const Query& query, DocumentStatus status, size_t max_result_count,
+	QueryCache::Key& key, std::vector<Document>& documents) const
+{
+	MakeQueryCacheKey(query, status, max_result_count, key);
+	return query_cache_->Find(key, index_version_, documents);
+}
+
 using MatchDocumentType = std::tuple<std::vector<std::string_view>, DocumentStatus>;
 
 MatchDocumentType SearchServer::MatchDocument(const std::string_view raw_query, int document_id) const
 {
-	//LOG_DURATION_STREAM(("Матчинг документов по запросу: " + raw_query), std::cout);
-
+	PROFILE_SCOPE("search.match_document");
+	const int ordinal = GetOrdinal(document_id);
 	const Query query = ParseQuery(raw_query, true);
 
 	std::vector<std::string_view> words;
 
-	if (std::any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(),
-			[this, &document_id](const auto word)
-			{
-				return document_to_word_freqs_.at(document_id).count(word) != 0;
-			})
-		)
+	if (HasMinusWord(ordinal, query))
 	{
-		return { words, documents_.at(document_id).status };
+		return { words, documents_.statuses[ordinal] };
 	}
 
 	for (const auto plus_word : query.plus_words)
 	{
-		if (word_to_document_freqs_.count(plus_word) == 1)
+		const PostingList* postings = FindPostings(plus_word);
+		if (postings != nullptr && postings->Contains(ordinal))
 		{
-			if (word_to_document_freqs_.at(plus_word).count(document_id))
-			{
-				words.push_back(plus_word);
-			}
+			words.push_back(plus_word);
 		}
 	}
 
-	return{ words, documents_.at(document_id).status };
+	return{ words, documents_.statuses[ordinal] };
 }
 
 MatchDocumentType SearchServer::MatchDocument(const std::execution::sequenced_policy&, const std::string_view raw_query, int document_id) const
@@ -130,21 +758,13 @@ MatchDocumentType SearchServer::MatchDocument(const std::execution::sequenced_po
 
 MatchDocumentType SearchServer::MatchDocument(const std::execution::parallel_policy&, const std::string_view raw_query, int document_id) const
 {
-	if (document_ids_.count(document_id) == 0) 
-	{
-		throw std::out_of_range("the document id does not exist");
-	}
-
+	PROFILE_SCOPE("search.match_document");
+	const int ordinal = GetOrdinal(document_id);
 	const Query query = ParseQuery(raw_query, false);
 
-	MatchDocumentType result { {}, documents_.at(document_id).status };
+	MatchDocumentType result { std::vector<std::string_view>{}, documents_.statuses[ordinal] };
 
-	if (std::any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(),
-			[this, &document_id](const auto word)
-			{
-				return document_to_word_freqs_.at(document_id).count(word) != 0;
-			})
-		)
+	if (HasMinusWord(ordinal, query))
 	{
 		return result;
 	}
@@ -152,9 +772,10 @@ MatchDocumentType SearchServer::MatchDocument(const std::execution::parallel_pol
 	std::get<0>(result).resize(query.plus_words.size());
 
 	auto it_end = std::copy_if(std::execution::par, query.plus_words.begin(), query.plus_words.end(),
-		std::get<0>(result).begin(), [this, &document_id](const auto word)
+		std::get<0>(result).begin(), [this, ordinal](const auto word)
 		{
-			return word_to_document_freqs_.count(word) && word_to_document_freqs_.at(word).count(document_id);
+			const PostingList* postings = FindPostings(word);
+			return postings != nullptr && postings->Contains(ordinal);
 		});
 	std::sort(std::get<0>(result).begin(), it_end);
 	it_end = std::unique(std::get<0>(result).begin(), it_end);
@@ -166,19 +787,39 @@ MatchDocumentType SearchServer::MatchDocument(const std::execution::parallel_pol
 
 bool SearchServer::IsStopWord(const std::string_view word) const
 {
-	return stop_words_.count(word) > 0;
+	return stop_words_.Find(word) != StringInterner::NOT_FOUND;
 }
 
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view text) const
+bool SearchServer::SplitIntoWordsNoStop(const std::string_view text, std::vector<std::string_view>& words) const
 {
-	std::vector<std::string_view> words;
-	for (const std::string_view word : SplitIntoWords(text))
+	const bool is_valid = SplitIntoWords(text, words);
+	if (!stop_words_.empty())
 	{
-		if (!IsStopWord(word))
-		{
-			words.push_back(word);
-		}
+		words.erase(std::remove_if(words.begin(), words.end(), [this](const std::string_view word)
+			{
+				return IsStopWord(word);
+			}), words.end());
+	}
+	if (is_valid)
+	{
+		return true;
 	}
+	// Управляющий символ мог встретиться только в стоп-слове.
+	return std::all_of(words.begin(), words.end(), [this](const std::string_view word)
+		{
+			return IsValidWord(word);
+		});
+}
+
+SearchServer::QueryContext& SearchServer::GetThreadLocalQueryContext()
+{
+	static thread_local QueryContext context;
+	return context;
+}
+
+std::vector<std::string_view>& SearchServer::GetThreadLocalWordBuffer()
+{
+	static thread_local std::vector<std::string_view> words;
 	return words;
 }
 
@@ -210,13 +851,17 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) cons
 SearchServer::Query SearchServer::ParseQuery(const std::string_view text, bool sort_needed) const
 {
 	Query query;
-	const std::vector<std::string_view> words(SplitIntoWords(text));
+	ParseQuery(text, query, sort_needed);
+	return query;
+}
 
-	if (!std::all_of(words.begin(), words.end(), [this](const auto word)
-			{
-				return IsValidWord(word);
-			})
-		)
+void SearchServer::ParseQuery(const std::string_view text, Query& query, bool sort_needed) const
+{
+	PROFILE_SCOPE("search.parse");
+	query.plus_words.clear();
+	query.minus_words.clear();
+	std::vector<std::string_view>& words = GetThreadLocalWordBuffer();
+	if (!SplitIntoWords(text, words))
 	{
 		throw std::invalid_argument("One or more words contain a special symbol");
 	}
@@ -246,53 +891,81 @@ SearchServer::Query SearchServer::ParseQuery(const std::string_view text, bool s
 			word->erase(unique(word->begin(), word->end()), word->end());
 		}
 	}
-	
-	return query;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const
+void SearchServer::UpdateWordDocumentFreq(int word_id)
 {
-	return std::log(documents_.size() * 1.0 / word_to_document_freqs_.at(word).size());
+	const size_t document_freq = word_postings_[word_id].size();
+	word_log_document_freqs_[word_id] = document_freq == 0 ? 0.0 : std::log(static_cast<double>(document_freq));
 }
 
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentStatus status) const
+void SearchServer::UpdateDocumentCount()
 {
-	return FindAllDocuments(query, [status](const int document_id, DocumentStatus document_status, const int rating)
-		{
-			return status == document_status;
-		});
+	const int document_count = GetDocumentCount();
+	log_document_count_ = document_count == 0 ? 0.0 : std::log(static_cast<double>(document_count));
 }
 
 bool SearchServer::IsValidWord(const std::string_view word) const
 {
-	return std::none_of(word.begin(), word.end(), [](char c)
-		{
-			return c >= 0 && c <= 31;
-		});
+	return !HasControlCharacters(word);
 }
 
 const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const
 {
 	static std::map<std::string_view, double> word_freqs;
-	const auto result = document_to_word_freqs_.find(document_id);
-	if (result == document_to_word_freqs_.end())
+	const int ordinal = FindOrdinal(document_id);
+	if (ordinal < 0)
 	{
 		return word_freqs;
 	}
+	if (IsMappedDocument(ordinal))
+	{
+		return mapped_index_->GetWordFrequencies(ordinal);
+	}
 
-	return result->second;
+	return document_to_word_freqs_[ordinal];
+}
+
+void SearchServer::GetDocumentWordIds(int document_id, std::vector<int>& word_ids) const
+{
+	word_ids.clear();
+	const int ordinal = FindOrdinal(document_id);
+	if (ordinal < 0)
+	{
+		return;
+	}
+	ForEachDocumentWord(ordinal, [&word_ids](int word_id)
+		{
+			word_ids.push_back(word_id);
+		});
+	std::sort(word_ids.begin(), word_ids.end());
 }
 
 void SearchServer::RemoveDocument(int document_id)
 {
-	documents_.erase(document_id);
-	document_ids_.erase(document_id);
-	const auto& words_in_document = GetWordFrequencies(document_id);
-	for (const auto& [word, _] : words_in_document)
+	const int ordinal = FindOrdinal(document_id);
+	if (ordinal < 0)
+	{
+		return;
+	}
+	++index_version_;
+
+	ForEachDocumentWord(ordinal, [this, ordinal](int word_id)
+		{
+			word_postings_[word_id].Erase(ordinal);
+			UpdateWordDocumentFreq(word_id);
+			ReleaseWordIfUnused(word_id);
+		});
+	document_to_word_freqs_[ordinal].clear();
+	if (IsMappedDocument(ordinal))
 	{
-		word_to_document_freqs_[word].erase(document_id);
+		mapped_ordinals_[ordinal] = false;
 	}
-	document_to_word_freqs_.erase(document_id);
+	documents_.Set(ordinal, -1, 0, DocumentStatus::REMOVED, 0.0);
+	free_ordinals_.push_back(ordinal);
+	document_id_to_ordinal_.erase(document_id);
+	document_ids_.erase(document_id);
+	UpdateDocumentCount();
 }
 
 void SearchServer::RemoveDocument(const std::execution::sequenced_policy&, int document_id)
@@ -302,21 +975,326 @@ void SearchServer::RemoveDocument(const std::execution::sequenced_policy&, int d
 
 void SearchServer::RemoveDocument(const std::execution::parallel_policy&, int document_id)
 {
-	if(document_ids_.count(document_id) == 0)
+	RemoveDocumentsImpl(std::execution::par, { document_id });
+}
+
+void SearchServer::RemoveDocuments(const std::vector<int>& document_ids)
+{
+	RemoveDocumentsImpl(std::execution::seq, document_ids);
+}
+
+void SearchServer::RemoveDocuments(const std::execution::sequenced_policy&, const std::vector<int>& document_ids)
+{
+	RemoveDocumentsImpl(std::execution::seq, document_ids);
+}
+
+void SearchServer::RemoveDocuments(const std::execution::parallel_policy&, const std::vector<int>& document_ids)
+{
+	RemoveDocumentsImpl(std::execution::par, document_ids);
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::RemoveDocumentsImpl(ExecutionPolicy&& policy, const std::vector<int>& document_ids)
+{
+	std::vector<bool> removed_ordinals(documents_.size(), false);
+	std::vector<int> ordinals;
+	for (const int document_id : document_ids)
+	{
+		const int ordinal = FindOrdinal(document_id);
+		if (ordinal >= 0 && !removed_ordinals[ordinal])
+		{
+			removed_ordinals[ordinal] = true;
+			ordinals.push_back(ordinal);
+		}
+	}
+	if (ordinals.empty())
 	{
 		return;
 	}
+	++index_version_;
+
+	std::vector<int> word_ids;
+	for (const int ordinal : ordinals)
+	{
+		ForEachDocumentWord(ordinal, [&word_ids](int word_id)
+			{
+				word_ids.push_back(word_id);
+			});
+	}
+	std::sort(policy, word_ids.begin(), word_ids.end());
+	word_ids.erase(std::unique(word_ids.begin(), word_ids.end()), word_ids.end());
 
-	auto& word_freq = document_to_word_freqs_.at(document_id);
-	std::vector<std::string_view> words(word_freq.size());
-	std::transform(std::execution::par, word_freq.begin(), word_freq.end(),
-		words.begin(),
-		[](const auto& word) { return word.first; });
-	std::for_each(std::execution::par, words.begin(), words.end(),
-		[this, document_id](const auto& word) {
-			word_to_document_freqs_[word].erase(document_id);
+	// Массив списков не меняет размер, пока разные списки вхождений
+	// обрабатываются параллельно, поэтому синхронизация не нужна.
+	std::for_each(policy, word_ids.begin(), word_ids.end(), [this, &removed_ordinals](int word_id)
+		{
+			word_postings_[word_id].Erase(removed_ordinals);
+			UpdateWordDocumentFreq(word_id);
 		});
-	documents_.erase(document_id);
-	document_ids_.erase(document_id);
-	document_to_word_freqs_.erase(document_id);
-}
\ No newline at end of file
+
+	for (const int word_id : word_ids)
+	{
+		ReleaseWordIfUnused(word_id);
+	}
+	for (const int ordinal : ordinals)
+	{
+		const int document_id = documents_.ids[ordinal];
+		document_to_word_freqs_[ordinal].clear();
+		if (IsMappedDocument(ordinal))
+		{
+			mapped_ordinals_[ordinal] = false;
+		}
+		documents_.Set(ordinal, -1, 0, DocumentStatus::REMOVED, 0.0);
+		free_ordinals_.push_back(ordinal);
+		document_id_to_ordinal_.erase(document_id);
+		document_ids_.erase(document_id);
+	}
+	UpdateDocumentCount();
+}
+
+void SearchServer::ReleaseWordIfUnused(int word_id)
+{
+	if (!word_postings_[word_id].empty())
+	{
+		return;
+	}
+	word_postings_[word_id] = PostingList();
+	word_log_document_freqs_[word_id] = 0.0;
+	words_.Release(word_id);
+	if (words_.empty())
+	{
+		word_postings_ = std::vector<PostingList>();
+		word_log_document_freqs_ = std::vector<double>();
+	}
+}
+
+int SearchServer::InternWord(const std::string_view word)
+{
+	const size_t word_count = words_.size();
+	const int word_id = words_.Intern(word);
+	if (words_.size() != word_count)
+	{
+		if (static_cast<size_t>(word_id) >= word_postings_.size())
+		{
+			word_postings_.resize(word_id + 1);
+			word_log_document_freqs_.resize(word_id + 1, 0.0);
+		}
+		word_postings_[word_id].SetCompressed(compress_postings_);
+	}
+	return word_id;
+}
+
+const PostingList* SearchServer::FindPostings(const std::string_view word) const
+{
+	const int word_id = words_.Find(word);
+	return word_id == StringInterner::NOT_FOUND ? nullptr : &word_postings_[word_id];
+}
+
+bool SearchServer::IsMappedDocument(int ordinal) const
+{
+	return static_cast<size_t>(ordinal) < mapped_ordinals_.size() && mapped_ordinals_[ordinal];
+}
+
+bool SearchServer::DocumentContainsWord(int ordinal, const std::string_view word) const
+{
+	if (!IsMappedDocument(ordinal))
+	{
+		return document_to_word_freqs_[ordinal].count(word) != 0;
+	}
+	// Номера слов открытого индекса совпадают с номерами в файле и
+	// упорядочены внутри документа.
+	const int word_id = words_.Find(word);
+	if (word_id == StringInterner::NOT_FOUND)
+	{
+		return false;
+	}
+	const IndexForwardEntry* last = mapped_index_->GetForwardEnd(ordinal);
+	const IndexForwardEntry* it = std::lower_bound(mapped_index_->GetForwardBegin(ordinal), last, word_id,
+		[](const IndexForwardEntry& entry, int word_id)
+		{
+			return static_cast<int>(entry.word_id) < word_id;
+		});
+	return it != last && static_cast<int>(it->word_id) == word_id;
+}
+
+template <typename Function>
+void SearchServer::ForEachDocumentWord(int ordinal, Function function) const
+{
+	if (IsMappedDocument(ordinal))
+	{
+		for (auto entry = mapped_index_->GetForwardBegin(ordinal); entry != mapped_index_->GetForwardEnd(ordinal); ++entry)
+		{
+			function(static_cast<int>(entry->word_id));
+		}
+		return;
+	}
+	for (const auto& [word, _] : document_to_word_freqs_[ordinal])
+	{
+		function(words_.Find(word));
+	}
+}
+
+void SearchServer::SaveIndex(const std::string& path) const
+{
+	std::vector<std::pair<std::string_view, const PostingList*>> terms;
+	terms.reserve(words_.size());
+	for (size_t word_id = 0; word_id < word_postings_.size(); ++word_id)
+	{
+		if (!word_postings_[word_id].empty())
+		{
+			terms.push_back({ words_.Get(static_cast<int>(word_id)), &word_postings_[word_id] });
+		}
+	}
+	std::sort(terms.begin(), terms.end());
+
+	IndexFileHeader header{};
+	header.stop_word_count = stop_words_.size();
+	header.word_count = terms.size();
+	header.document_count = documents_.size();
+	header.free_ordinal_count = free_ordinals_.size();
+
+	std::vector<std::string_view> stop_words;
+	for (size_t stop_word_id = 0; stop_word_id < stop_words_.GetIdBound(); ++stop_word_id)
+	{
+		stop_words.push_back(stop_words_.Get(static_cast<int>(stop_word_id)));
+	}
+	std::sort(stop_words.begin(), stop_words.end());
+	std::vector<std::string_view> words;
+	std::vector<IndexTermRecord> term_records;
+	std::vector<Posting> postings;
+	uint64_t stop_words_bytes = 0;
+	uint64_t words_bytes = 0;
+	for (const std::string_view word : stop_words)
+	{
+		stop_words_bytes += word.size();
+	}
+	for (const auto& [word, word_postings] : terms)
+	{
+		words.push_back(word);
+		words_bytes += word.size();
+		term_records.push_back({ postings.size(), word_postings->size(), word_postings->GetMaxTermFreq() });
+		for (PostingList::Cursor cursor(*word_postings); cursor.IsValid(); cursor.Next())
+		{
+			postings.push_back(cursor.Get());
+		}
+	}
+	header.posting_count = postings.size();
+	header.forward_entry_count = postings.size();
+
+	// Прямой индекс восстанавливается из списков вхождений раскладкой по документам.
+	// Слова обходятся по возрастанию номера, поэтому внутри документа они упорядочены.
+	std::vector<uint64_t> forward_offsets(documents_.size() + 1, 0);
+	for (const Posting& posting : postings)
+	{
+		++forward_offsets[posting.ordinal + 1];
+	}
+	std::partial_sum(forward_offsets.begin(), forward_offsets.end(), forward_offsets.begin());
+	std::vector<IndexForwardEntry> forward_entries(postings.size());
+	{
+		std::vector<uint64_t> positions(forward_offsets.begin(), forward_offsets.end() - 1);
+		for (size_t word_id = 0; word_id < term_records.size(); ++word_id)
+		{
+			const IndexTermRecord& term = term_records[word_id];
+			for (uint64_t i = term.first_posting; i < term.first_posting + term.posting_count; ++i)
+			{
+				forward_entries[positions[postings[i].ordinal]++] = { static_cast<uint32_t>(word_id), postings[i].term_count };
+			}
+		}
+	}
+
+	std::vector<IndexDocumentRecord> document_records;
+	document_records.reserve(documents_.size());
+	for (size_t ordinal = 0; ordinal < documents_.size(); ++ordinal)
+	{
+		document_records.push_back({ documents_.ids[ordinal], documents_.ratings[ordinal],
+			static_cast<int32_t>(documents_.statuses[ordinal]), 0, documents_.inv_word_counts[ordinal] });
+	}
+	const std::vector<int32_t> free_ordinals(free_ordinals_.begin(), free_ordinals_.end());
+
+	ComputeIndexFileLayout(header, stop_words_bytes, words_bytes);
+
+	const std::string temporary_path = path + ".tmp";
+	{
+		std::ofstream output(temporary_path, std::ios::binary | std::ios::trunc);
+		if (!output)
+		{
+			throw std::runtime_error("cannot create index file " + temporary_path);
+		}
+		WriteIndexRecords(output, &header, 1);
+		WriteIndexPadding(output);
+		WriteIndexStringTable(output, stop_words);
+		WriteIndexStringTable(output, words);
+		WriteIndexRecords(output, term_records.data(), term_records.size());
+		WriteIndexPadding(output);
+		WriteIndexRecords(output, document_records.data(), document_records.size());
+		WriteIndexPadding(output);
+		WriteIndexRecords(output, free_ordinals.data(), free_ordinals.size());
+		WriteIndexPadding(output);
+		WriteIndexRecords(output, forward_offsets.data(), forward_offsets.size());
+		WriteIndexPadding(output);
+		WriteIndexRecords(output, forward_entries.data(), forward_entries.size());
+		WriteIndexPadding(output);
+		WriteIndexRecords(output, postings.data(), postings.size());
+		WriteIndexPadding(output);
+		if (!output || static_cast<uint64_t>(output.tellp()) != header.file_size)
+		{
+			throw std::runtime_error("cannot write index file " + temporary_path);
+		}
+	}
+	if (std::rename(temporary_path.c_str(), path.c_str()) != 0)
+	{
+		std::remove(temporary_path.c_str());
+		throw std::runtime_error("cannot replace index file " + path);
+	}
+}
+
+SearchServer SearchServer::OpenIndex(const std::string& path)
+{
+	auto index = std::make_shared<const MappedIndex>(path);
+	const IndexFileHeader& header = index->GetHeader();
+
+	SearchServer server;
+	for (size_t i = 0; i < header.stop_word_count; ++i)
+	{
+		server.stop_words_.InternExternal(index->GetStopWord(i));
+	}
+
+	server.documents_.Resize(header.document_count);
+	server.document_to_word_freqs_.resize(header.document_count);
+	server.mapped_ordinals_.assign(header.document_count, false);
+	server.document_id_to_ordinal_.reserve(header.document_count);
+	for (size_t ordinal = 0; ordinal < header.document_count; ++ordinal)
+	{
+		const IndexDocumentRecord& record = index->GetDocument(ordinal);
+		server.documents_.Set(static_cast<int>(ordinal), record.id, record.rating, static_cast<DocumentStatus>(record.status),
+			record.inv_word_count);
+		if (record.id >= 0)
+		{
+			if (!server.document_id_to_ordinal_.emplace(record.id, static_cast<int>(ordinal)).second)
+			{
+				throw std::runtime_error("index file has duplicate document ids");
+			}
+			server.document_ids_.insert(record.id);
+			server.mapped_ordinals_[ordinal] = true;
+		}
+	}
+	server.free_ordinals_.assign(index->GetFreeOrdinals(), index->GetFreeOrdinals() + header.free_ordinal_count);
+
+	// Словарь пуст, поэтому номера слов совпадают с номерами в файле.
+	server.word_postings_.reserve(header.word_count);
+	for (size_t word_id = 0; word_id < header.word_count; ++word_id)
+	{
+		const IndexTermRecord& term = index->GetTerm(word_id);
+		if (server.words_.InternExternal(index->GetWord(word_id)) != static_cast<int>(word_id))
+		{
+			throw std::runtime_error("index file has duplicate words");
+		}
+		server.word_postings_.emplace_back(index->GetPostings(term), term.posting_count, term.max_term_freq);
+		server.word_log_document_freqs_.push_back(0.0);
+		server.UpdateWordDocumentFreq(static_cast<int>(word_id));
+	}
+	server.UpdateDocumentCount();
+
+	server.mapped_index_ = std::move(index);
+	return server;
+}
@@ -3,17 +3,32 @@
 #include <string_view>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <tuple>
 #include <numeric>
 #include <algorithm>
+#include <array>
 #include <set>
 #include <execution>
+#include <thread>
 #include <stdexcept>
+#include <limits>
+#include <memory>
+#include <cstdint>
+#include <type_traits>
 
 #include "document.h"
 #include "string_processing.h"
-#include "log_duration.h"
-#include "concurrent_map.h"
+#include "profiler.h"
+#include "index_file.h"
+#include "string_interner.h"
+#include "posting_list.h"
+#include "relevance_accumulator.h"
+#include "ordinal_bitmap.h"
+#include "document_filter.h"
+#include "top_documents.h"
+#include "query_cache.h"
+#include "thread_pool.h"
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 
@@ -41,10 +56,33 @@ public:
 	void AddDocument(int document_id, const std::string_view document,
 		DocumentStatus status, const std::vector<int>& ratings);
 
+	struct NewDocument
+	{
+		int document_id;
+		std::string_view document;
+		DocumentStatus status;
+		std::vector<int> ratings;
+	};
+
+	// Добавляет набор документов: разбор и проверка текстов выполняются параллельно,
+	// индекс пополняется за один проход. Результат и исключения такие же, как при
+	// последовательных вызовах AddDocument: документы до первого ошибочного
+	// добавляются, затем выбрасывается то же исключение.
+	void AddDocuments(const std::vector<NewDocument>& documents);
+	void AddDocuments(const std::execution::sequenced_policy&, const std::vector<NewDocument>& documents);
+	void AddDocuments(const std::execution::parallel_policy&, const std::vector<NewDocument>& documents);
+
 	int GetDocumentCount() const;
 
 	const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
 
+	// Записывает в word_ids номера слов документа по возрастанию. Номер слова
+	// одинаков во всех документах, поэтому наборы слов можно сравнивать по номерам.
+	void GetDocumentWordIds(int document_id, std::vector<int>& word_ids) const;
+
+	// Вместо политики исполнения можно передать ThreadPool: крупный запрос делится
+	// на диапазоны документов между потоками пула, небольшой выполняется в текущем
+	// потоке с отсечением по MaxScore.
 	template <typename ExecutionPolicy>
 	std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query) const;
 	std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
@@ -52,6 +90,43 @@ public:
 	std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, Criterion criterion) const;
 	template <typename Criterion>
 	std::vector<Document> FindTopDocuments(const std::string_view raw_query, Criterion criterion) const;
+	template <typename ExecutionPolicy, typename Criterion>
+	std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, Criterion criterion,
+		size_t max_result_count) const;
+	template <typename Criterion>
+	std::vector<Document> FindTopDocuments(const std::string_view raw_query, Criterion criterion, size_t max_result_count) const;
+
+	// Выполняет набор запросов, разделяя между ними обход списков вхождений: список
+	// слова, встречающегося в нескольких запросах, читается один раз, а вклады документов
+	// раздаются этим запросам. Одинаковые запросы выполняются однократно. Результат
+	// совпадает с FindTopDocuments для каждого запроса; кеш результатов не используется.
+	std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries) const;
+	std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+		DocumentStatus status, size_t max_result_count) const;
+
+	// Страница выдачи: документы с позиций [offset, offset + limit). Ищется топ из
+	// offset + limit документов, из которого возвращается только страница.
+	template <typename Criterion>
+	std::vector<Document> FindTopDocumentsPage(const std::string_view raw_query, Criterion criterion,
+		size_t offset, size_t limit) const;
+
+	// Продолжение выдачи по курсору: limit документов, следующих в порядке выдачи
+	// за документом after, обычно последним документом предыдущей страницы. Куча
+	// держит только limit документов, поэтому глубокая страница стоит столько же,
+	// сколько первая. Кеш результатов не используется.
+	template <typename Criterion>
+	std::vector<Document> FindTopDocumentsAfter(const std::string_view raw_query, Criterion criterion,
+		const Document& after, size_t limit) const;
+
+	class QueryContext;
+
+	// Последовательный поиск в памяти контекста. После прогрева на похожих запросах
+	// разбор, поиск и выдача результата не выделяют память. Результат хранится
+	// в контексте и действителен до следующего поиска с ним.
+	const std::vector<Document>& FindTopDocuments(QueryContext& context, const std::string_view raw_query) const;
+	template <typename Criterion>
+	const std::vector<Document>& FindTopDocuments(QueryContext& context, const std::string_view raw_query, Criterion criterion,
+		size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
 	using MatchDocumentType = std::tuple<std::vector<std::string_view>, DocumentStatus>;
 
@@ -63,26 +138,136 @@ public:
 	void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
 	void RemoveDocument(const std::execution::parallel_policy&, int document_id);
 
+	// Удаляет набор документов за один проход по затронутым спискам вхождений.
+	// Отсутствующие id пропускаются.
+	void RemoveDocuments(const std::vector<int>& document_ids);
+	void RemoveDocuments(const std::execution::sequenced_policy&, const std::vector<int>& document_ids);
+	void RemoveDocuments(const std::execution::parallel_policy&, const std::vector<int>& document_ids);
+
+	// Включает хранение списков вхождений в сжатом виде (разности номеров в varint).
+	// Уже построенные списки перепаковываются, новые создаются в выбранном режиме.
+	void SetPostingsCompression(bool enabled);
+
+	bool IsPostingsCompressionEnabled() const;
+
+	// Оценка занимаемой индексом памяти в байтах по структурам данных.
+	struct MemoryUsage
+	{
+		size_t documents = 0;
+		size_t forward_index = 0;
+		size_t term_dictionary = 0;
+		size_t postings = 0;
+		size_t words = 0;
+
+		size_t GetTotal() const;
+	};
+
+	MemoryUsage GetMemoryUsage() const;
+
+	// Включает кеш результатов FindTopDocuments на capacity запросов. Кешируются
+	// поиски по статусу документа (в том числе по умолчанию); поиск с произвольным
+	// предикатом всегда выполняется заново. Любое изменение индекса увеличивает его
+	// версию, и записи, полученные на прежней версии, больше не выдаются.
+	void EnableQueryCache(size_t capacity);
+
+	void DisableQueryCache();
+
+	QueryCache::Stats GetQueryCacheStats() const;
+
+	uint64_t GetIndexVersion() const;
+
+	// Сохраняет индекс в двоичный файл: стоп-слова, словарь, списки вхождений,
+	// документы и прямой индекс. Файл сначала пишется рядом с path и затем
+	// переименовывается, поэтому открытый через OpenIndex файл можно перезаписывать.
+	void SaveIndex(const std::string& path) const;
+
+	// Открывает файл индекса через отображение в память. Слова и списки вхождений
+	// не копируются: поиск идёт прямо по страницам файла, которые несколько процессов
+	// делят через кеш страниц. Список копируется в память при первом изменении.
+	// Списки открытого индекса хранятся несжатыми.
+	static SearchServer OpenIndex(const std::string& path);
+
 private:
 
-	struct DocumentInfo
+	// Атрибуты документов хранятся по столбцам: фильтры и предикаты читают
+	// подряд только нужные им массивы.
+	struct DocumentColumns
 	{
-		int rating;
-		DocumentStatus status;
+		std::vector<int> ids;
+		std::vector<int> ratings;
+		std::vector<DocumentStatus> statuses;
+		std::vector<double> inv_word_counts;
+
+		size_t size() const;
+
+		void Resize(size_t size);
+
+		void Set(int ordinal, int id, int rating, DocumentStatus status, double inv_word_count);
+
+		size_t GetMemoryUsage() const;
 	};
 
-	std::map<int, DocumentInfo> documents_;
+	// Документы хранятся в плотных массивах по внутреннему порядковому номеру (ordinal).
+	// Номера удалённых документов переиспользуются при следующих добавлениях.
+	DocumentColumns documents_;
+	std::vector<std::map<std::string_view, double>> document_to_word_freqs_;
+	std::unordered_map<int, int> document_id_to_ordinal_;
+	std::vector<int> free_ordinals_;
 	std::set<int> document_ids_;
-	std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-	std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
-	std::set<std::string, std::less<>> stop_words_;
-	std::set<std::string, std::less<>> all_words_;
+	// Слова хранятся в арене и имеют плотные номера; списки вхождений лежат
+	// в массиве по номеру слова. Ключи прямого индекса указывают на строки арены.
+	StringInterner words_;
+	std::vector<PostingList> word_postings_;
+	StringInterner stop_words_;
+	// IDF слова равен log_document_count_ - word_log_document_freqs_[word_id].
+	// Оба логарифма пересчитываются изменяющими индекс методами, поэтому поиск
+	// не вычисляет логарифмов.
+	std::vector<double> word_log_document_freqs_;
+	double log_document_count_ = 0.0;
+	bool compress_postings_ = false;
+
+	// Открытый файл индекса. Строки словаря и прямой индекс документов,
+	// отмеченных в mapped_ordinals_, указывают на его страницы.
+	std::shared_ptr<const MappedIndex> mapped_index_;
+	std::vector<bool> mapped_ordinals_;
+
+	uint64_t index_version_ = 0;
+	std::unique_ptr<QueryCache> query_cache_;
+
+	int FindOrdinal(int document_id) const;
+
+	int GetOrdinal(int document_id) const;
+
+	void ReleaseWordIfUnused(int word_id);
+
+	// Возвращает номер слова, добавляя его в словарь с пустым списком вхождений.
+	int InternWord(const std::string_view word);
+
+	const PostingList* FindPostings(const std::string_view word) const;
+
+	bool IsMappedDocument(int ordinal) const;
+
+	bool DocumentContainsWord(int ordinal, const std::string_view word) const;
+
+	template <typename Function>
+	void ForEachDocumentWord(int ordinal, Function function) const;
+
+	template <typename ExecutionPolicy>
+	void AddDocumentsImpl(ExecutionPolicy&& policy, const std::vector<NewDocument>& documents);
+
+	template <typename ExecutionPolicy>
+	void RemoveDocumentsImpl(ExecutionPolicy&& policy, const std::vector<int>& document_ids);
 
 	bool IsStopWord(const std::string_view word) const;
 
 	bool IsValidWord(const std::string_view word) const;
 
-	std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view text) const;
+	// Разбивает текст на слова без стоп-слов в переданный буфер.
+	// Возвращает false, если одно из оставшихся слов содержит управляющий символ.
+	bool SplitIntoWordsNoStop(const std::string_view text, std::vector<std::string_view>& words) const;
+
+	// Буфер слов потока для разбора документов и запросов без выделения памяти.
+	static std::vector<std::string_view>& GetThreadLocalWordBuffer();
 
 	static int ComputeAverageRating(const std::vector<int>& ratings);
 
@@ -103,159 +288,515 @@ private:
 
 	Query ParseQuery(const std::string_view text, bool sort_needed = true) const;
 
-	double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+	void ParseQuery(const std::string_view text, Query& query, bool sort_needed = true) const;
+
+	// Контекст потока для последовательного поиска через FindTopDocuments без контекста.
+	static QueryContext& GetThreadLocalQueryContext();
+
+	static void MakeQueryCacheKey(const Query& query, DocumentStatus status, size_t max_result_count, QueryCache::Key& key);
+
+	// Ищет результат в кеше; построенный ключ остаётся в key для сохранения результата.
+	bool FindCachedDocuments(const Query& query, DocumentStatus status, size_t max_result_count,
+		QueryCache::Key& key, std::vector<Document>& documents) const;
+
+	// Запрос пакета в виде номеров слов; плюс-слова в порядке суммирования вкладов.
+	struct BatchQuery
+	{
+		std::vector<int> plus_word_ids;
+		std::vector<int> minus_word_ids;
+	};
+
+	void FindBatchGroupDocuments(const std::vector<BatchQuery>& queries, size_t first_query, size_t last_query,
+		DocumentStatus status, size_t max_result_count, std::vector<std::vector<Document>>& results) const;
 
-	std::vector<Document> FindAllDocuments(const Query& query, DocumentStatus status) const;
+	// Отмечает документы, содержащие минус-слова запроса.
+	void FillExcludedDocuments(const Query& query, OrdinalBitmap& excluded) const;
 
+	// Проверка одного документа: минус-слова ищутся в его прямом индексе.
+	bool HasMinusWord(int ordinal, const Query& query) const;
+
+	double GetWordInverseDocumentFreq(int word_id) const
+	{
+		return log_document_count_ - word_log_document_freqs_[word_id];
+	}
+
+	void UpdateWordDocumentFreq(int word_id);
+
+	void UpdateDocumentCount();
+
+	// Предикат декларативного фильтра: проверка бита в карте, вычисленной по столбцам,
+	// или построчная проверка, если карта не строилась.
+	struct FilterPredicate
+	{
+		const DocumentFilter* filter;
+		const uint64_t* bits;
+		const DocumentColumns* documents;
+
+		bool operator()(int ordinal) const
+		{
+			if (bits != nullptr)
+			{
+				return (bits[ordinal >> 6] >> (ordinal & 63)) & 1;
+			}
+			return (*filter)(documents->ids[ordinal], documents->statuses[ordinal], documents->ratings[ordinal]);
+		}
+	};
+
+	// Предикаты поиска принимают порядковый номер документа и читают только нужные столбцы.
+	// Запрос и буфер filter_bits нужны только фильтру DocumentFilter.
+	auto MakeDocumentPredicate(DocumentStatus status, const Query&, std::vector<uint64_t>&) const
+	{
+		return [statuses = documents_.statuses.data(), status](int ordinal)
+			{
+				return statuses[ordinal] == status;
+			};
+	}
 	template <typename Criterion>
-	std::vector<Document> FindAllDocuments(const Query& query, Criterion criterion) const;
+	auto MakeDocumentPredicate(Criterion criterion, const Query&, std::vector<uint64_t>&) const
+	{
+		return [&documents = documents_, criterion](int ordinal)
+			{
+				return criterion(documents.ids[ordinal], documents.statuses[ordinal], documents.ratings[ordinal]);
+			};
+	}
+	// Фильтр вычисляется в filter_bits, если слова запроса встречаются в заметной
+	// доле документов: иначе дешевле проверить только найденные документы.
+	FilterPredicate MakeDocumentPredicate(const DocumentFilter& filter, const Query& query, std::vector<uint64_t>& filter_bits) const;
+
+	// Контекстный поиск по запросу, уже разобранному в context.query_: с кешем результатов.
 	template <typename Criterion>
-	std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, Criterion criterion) const;
+	const std::vector<Document>& FindParsedTopDocuments(QueryContext& context, Criterion criterion,
+		size_t max_result_count) const;
+	// Ищет документы по разобранному запросу context.query_ и записывает результат в context.documents_.
+	// При заданном after отбираются только документы, следующие за ним в порядке выдачи.
 	template <typename Criterion>
-	std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, Criterion criterion) const;
+	void FindAllDocumentsWithPruning(QueryContext& context, Criterion criterion, size_t max_result_count,
+		const Document* after = nullptr) const;
+	// Исчерпывающий поиск, разделённый на диапазоны порядковых номеров документов.
+	template <typename ExecutionPolicy, typename Criterion>
+	std::vector<Document> FindAllDocuments(ExecutionPolicy& policy, const Query& query, Criterion criterion,
+		size_t max_result_count) const;
+
+	// Запрос с меньшим числом вхождений плюс-слов пул выполняет в одном потоке.
+	static const size_t MIN_PARALLEL_QUERY_POSTINGS = 64 * 1024;
+
+	size_t CountPlusWordPostings(const Query& query) const;
+};
+
+// Рабочая память запроса: разобранный запрос, курсоры списков вхождений, куча
+// лучших документов и результат. Ёмкость векторов сохраняется между запросами.
+// Контекст можно использовать только из одного потока одновременно.
+class SearchServer::QueryContext
+{
+public:
+
+	QueryContext() = default;
+
+private:
+
+	friend class SearchServer;
+
+	struct TermCursor
+	{
+		PostingList::Cursor postings;
+		double inverse_document_freq;
+		double upper_bound;
+		size_t word_index;
+	};
+
+	Query query_;
+	std::vector<TermCursor> cursors_;
+	// Буферы распаковки курсоров сжатых списков, по MAX_BLOCK_SIZE вхождений на слово.
+	std::vector<Posting> cursor_buffers_;
+	OrdinalBitmap excluded_;
+	std::vector<uint64_t> filter_bits_;
+	std::vector<double> upper_bound_prefix_;
+	std::vector<double> contributions_;
+	std::vector<bool> has_contribution_;
+	TopDocuments top_documents_ = TopDocuments(0);
+	QueryCache::Key cache_key_;
+	std::vector<Document> documents_;
 };
 
 
+std::ostream& operator<<(std::ostream& os, const SearchServer::MemoryUsage& usage);
+
 template <typename StringContainer>
 SearchServer::SearchServer(const StringContainer& stop_words)
-	: stop_words_(MakeUniqueNonEmptyStrings(stop_words))
 {
-	if (!std::all_of(stop_words_.begin(), stop_words_.end(), [this](const std::string& word)
+	const auto unique_stop_words = MakeUniqueNonEmptyStrings(stop_words);
+	if (!std::all_of(unique_stop_words.begin(), unique_stop_words.end(), [this](const std::string& word)
 		{
 			return IsValidWord(word);
 		}))
 	{
 		throw std::invalid_argument("One or more stop words contain a special symbol");
 	}
+	for (const std::string& word : unique_stop_words)
+	{
+		stop_words_.Intern(word);
+	}
 }
 
 template <typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query) const
 {
-	return FindTopDocuments(policy, raw_query, [](const int document_id, DocumentStatus status, int rating)
-		{
-			return status == DocumentStatus::ACTUAL;
-		});
+	return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
 template <typename ExecutionPolicy, typename Criterion>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, Criterion criterion) const
 {
-	//LOG_DURATION_STREAM(("Результаты поиска по запросу: " + raw_query), std::cout);
-	const Query query = ParseQuery(raw_query, true);
-
-	auto matched_documents = FindAllDocuments(policy, query, criterion);
-
-	sort(matched_documents.begin(), matched_documents.end(),
-		[](const Document& lhs, const Document& rhs)
-		{
-			return lhs > rhs;
-		});
-
-	if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
-	{
-		matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-	}
-
-	return matched_documents;
+	return FindTopDocuments(policy, raw_query, criterion, MAX_RESULT_DOCUMENT_COUNT);
 }
 
 template <typename Criterion>
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, Criterion criterion) const
 {
-	return FindTopDocuments(std::execution::seq, raw_query, criterion);
+	return FindTopDocuments(std::execution::seq, raw_query, criterion, MAX_RESULT_DOCUMENT_COUNT);
 }
 
-template <typename Criterion>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, Criterion criterion) const
+template <typename ExecutionPolicy, typename Criterion>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, Criterion criterion,
+	size_t max_result_count) const
 {
-	std::map<int, double> document_to_relevance;
-	for (const auto& word : query.plus_words)
+	PROFILE_SCOPE("search.query");
+	if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::parallel_policy>
+		|| std::is_same_v<std::decay_t<ExecutionPolicy>, ThreadPool>)
 	{
-		if (word_to_document_freqs_.count(word) == 0)
+		// Параллельный поиск не берёт контекст потока: пока поток ждёт задачи
+		// поиска, он может выполнить другой запрос с тем же контекстом.
+		Query query = ParseQuery(raw_query, true);
+		if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, ThreadPool>)
 		{
-			continue;
+			if (policy.GetThreadCount() == 1 || CountPlusWordPostings(query) < MIN_PARALLEL_QUERY_POSTINGS)
+			{
+				// Запрос уже разобран: последовательный поиск продолжается с ним.
+				QueryContext& context = GetThreadLocalQueryContext();
+				context.query_ = std::move(query);
+				return FindParsedTopDocuments(context, criterion, max_result_count);
+			}
 		}
-		const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-		for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word))
+		QueryCache::Key key;
+		std::vector<Document> documents;
+		std::vector<uint64_t> filter_bits;
+		if constexpr (std::is_same_v<Criterion, DocumentStatus>)
 		{
-			const auto& document_id_data = documents_.at(document_id);
-			if (criterion(document_id, document_id_data.status, document_id_data.rating)) 
+			if (query_cache_ && FindCachedDocuments(query, criterion, max_result_count, key, documents))
 			{
-				document_to_relevance[document_id] += term_freq * inverse_document_freq;
+				return documents;
 			}
 		}
+		documents = FindAllDocuments(policy, query, MakeDocumentPredicate(criterion, query, filter_bits), max_result_count);
+		if constexpr (std::is_same_v<Criterion, DocumentStatus>)
+		{
+			if (query_cache_)
+			{
+				query_cache_->Insert(std::move(key), index_version_, documents);
+			}
+		}
+		return documents;
+	}
+	else
+	{
+		return FindTopDocuments(GetThreadLocalQueryContext(), raw_query, criterion, max_result_count);
 	}
+}
 
-	for (const auto& word : query.minus_words)
+template <typename Criterion>
+const std::vector<Document>& SearchServer::FindTopDocuments(QueryContext& context, const std::string_view raw_query, Criterion criterion,
+	size_t max_result_count) const
+{
+	ParseQuery(raw_query, context.query_, true);
+	return FindParsedTopDocuments(context, criterion, max_result_count);
+}
+
+template <typename Criterion>
+const std::vector<Document>& SearchServer::FindParsedTopDocuments(QueryContext& context, Criterion criterion,
+	size_t max_result_count) const
+{
+	if constexpr (std::is_same_v<Criterion, DocumentStatus>)
 	{
-		if (word_to_document_freqs_.count(word) == 0)
+		if (query_cache_ && FindCachedDocuments(context.query_, criterion, max_result_count, context.cache_key_, context.documents_))
 		{
-			continue;
+			return context.documents_;
 		}
-		for (const auto& [document_id, _] : word_to_document_freqs_.at(word))
+	}
+	FindAllDocumentsWithPruning(context, MakeDocumentPredicate(criterion, context.query_, context.filter_bits_), max_result_count);
+	if constexpr (std::is_same_v<Criterion, DocumentStatus>)
+	{
+		if (query_cache_)
 		{
-			document_to_relevance.erase(document_id);
+			query_cache_->Insert(context.cache_key_, index_version_, context.documents_);
 		}
 	}
+	return context.documents_;
+}
 
-	std::vector<Document> matched_documents;
-	for (const auto& [document_id, relevance] : document_to_relevance)
+template <typename Criterion>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, Criterion criterion, size_t max_result_count) const
+{
+	return FindTopDocuments(std::execution::seq, raw_query, criterion, max_result_count);
+}
+
+template <typename Criterion>
+std::vector<Document> SearchServer::FindTopDocumentsPage(const std::string_view raw_query, Criterion criterion,
+	size_t offset, size_t limit) const
+{
+	const std::vector<Document>& documents = FindTopDocuments(GetThreadLocalQueryContext(), raw_query, criterion, offset + limit);
+	if (offset >= documents.size())
 	{
-		matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+		return {};
 	}
-	return matched_documents;
+	return std::vector<Document>(documents.begin() + offset, documents.end());
 }
 
 template <typename Criterion>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, Criterion criterion) const
+std::vector<Document> SearchServer::FindTopDocumentsAfter(const std::string_view raw_query, Criterion criterion,
+	const Document& after, size_t limit) const
 {
-	return FindAllDocuments(query, criterion);
+	QueryContext& context = GetThreadLocalQueryContext();
+	ParseQuery(raw_query, context.query_, true);
+	FindAllDocumentsWithPruning(context, MakeDocumentPredicate(criterion, context.query_, context.filter_bits_), limit, &after);
+	return context.documents_;
 }
 
-template<typename Criterion>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, Criterion criterion) const
+// Поиск топ-K по схеме MaxScore. Слова запроса упорядочены по верхней границе вклада
+// max(term_freq) * IDF; слова, суммарная граница которых не дотягивает до худшего
+// документа в топе, становятся «необязательными»: по их спискам кандидаты не
+// порождаются, а лишь проверяются двоичным поиском. Документы с минус-словами
+// отбрасываются по битовой карте до подсчёта релевантности. Результат совпадает
+// с полным перебором в параллельном FindAllDocuments, релевантность суммируется
+// в том же порядке слов.
+template <typename Criterion>
+void SearchServer::FindAllDocumentsWithPruning(QueryContext& context, Criterion criterion, size_t max_result_count,
+	const Document* after) const
 {
-	ConcurrentMap<int, double> document_to_relevance(std::max(static_cast<int>(query.plus_words.size()), 100));
+	using TermCursor = QueryContext::TermCursor;
+	const Query& query = context.query_;
+
+	std::vector<TermCursor>& cursors = context.cursors_;
+	cursors.clear();
+	context.cursor_buffers_.resize(query.plus_words.size() * PostingList::MAX_BLOCK_SIZE);
+	for (size_t word_index = 0; word_index < query.plus_words.size(); ++word_index)
+	{
+		const int word_id = words_.Find(query.plus_words[word_index]);
+		if (word_id == StringInterner::NOT_FOUND || word_postings_[word_id].empty())
+		{
+			continue;
+		}
+		const PostingList& postings = word_postings_[word_id];
+		const double inverse_document_freq = GetWordInverseDocumentFreq(word_id);
+		Posting* const buffer = context.cursor_buffers_.data() + cursors.size() * PostingList::MAX_BLOCK_SIZE;
+		cursors.push_back({ PostingList::Cursor(postings, buffer), inverse_document_freq,
+			postings.GetMaxTermFreq() * inverse_document_freq, word_index });
+	}
+
+	OrdinalBitmap& excluded = context.excluded_;
+	FillExcludedDocuments(query, excluded);
+	PROFILE_COUNTER("search.terms", static_cast<int64_t>(cursors.size()));
+	// Подсчёт релевантности и пополнение топа идут внутри обхода по кандидатам
+	// и отдельно не измеряются.
+	PROFILE_SCOPE("search.traverse");
+
+	std::sort(cursors.begin(), cursors.end(), [](const TermCursor& lhs, const TermCursor& rhs)
+		{
+			return lhs.upper_bound < rhs.upper_bound;
+		});
+	std::vector<double>& upper_bound_prefix = context.upper_bound_prefix_;
+	upper_bound_prefix.assign(cursors.size() + 1, 0.0);
+	for (size_t i = 0; i < cursors.size(); ++i)
+	{
+		upper_bound_prefix[i + 1] = upper_bound_prefix[i] + cursors[i].upper_bound;
+	}
 
-	std::for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(), [&document_to_relevance, this, &criterion](const auto& word) 
+	// Документ с релевантностью ниже порога не может вытеснить худший документ топа
+	// ни по релевантности, ни по рейтингу. Запас покрывает погрешность порядка суммирования.
+	const double rounding_margin = 1e-9;
+	double threshold = -std::numeric_limits<double>::infinity();
+	size_t first_essential = 0;
+
+	std::vector<double>& contributions = context.contributions_;
+	contributions.assign(query.plus_words.size(), 0.0);
+	std::vector<bool>& has_contribution = context.has_contribution_;
+	has_contribution.assign(query.plus_words.size(), false);
+	TopDocuments& top_documents = context.top_documents_;
+	top_documents.Reset(max_result_count);
+	if (after)
+	{
+		top_documents.SetCursor(*after);
+	}
+
+	while (true)
+	{
+		int candidate = std::numeric_limits<int>::max();
+		for (size_t i = first_essential; i < cursors.size(); ++i)
 		{
-			if (word_to_document_freqs_.count(word) != 0) 
+			if (cursors[i].postings.IsValid())
 			{
-				const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-				for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) 
+				candidate = std::min(candidate, cursors[i].postings.Get().ordinal);
+			}
+		}
+		if (candidate == std::numeric_limits<int>::max())
+		{
+			break;
+		}
+
+		if (excluded.Contains(candidate))
+		{
+			for (size_t i = first_essential; i < cursors.size(); ++i)
+			{
+				auto& cursor = cursors[i].postings;
+				if (cursor.IsValid() && cursor.Get().ordinal == candidate)
 				{
-					const auto& document_id_data = documents_.at(document_id);
-					if (criterion(document_id, document_id_data.status, document_id_data.rating)) 
-					{
-						document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-					}
+					cursor.Next();
 				}
 			}
-		});
+			continue;
+		}
+
+		const double inv_word_count = documents_.inv_word_counts[candidate];
+		std::fill(has_contribution.begin(), has_contribution.end(), false);
+		double score = 0.0;
+		for (size_t i = first_essential; i < cursors.size(); ++i)
+		{
+			auto& cursor = cursors[i];
+			if (cursor.postings.IsValid() && cursor.postings.Get().ordinal == candidate)
+			{
+				const double contribution = cursor.postings.Get().term_count * inv_word_count * cursor.inverse_document_freq;
+				contributions[cursor.word_index] = contribution;
+				has_contribution[cursor.word_index] = true;
+				score += contribution;
+				cursor.postings.Next();
+			}
+		}
+
+		if (score + upper_bound_prefix[first_essential] < threshold)
+		{
+			continue;
+		}
 
+		if (!criterion(candidate))
+		{
+			continue;
+		}
 
-	std::for_each(std::execution::par, query.minus_words.begin(), query.minus_words.end(), 
-		[&document_to_relevance, this](const auto& word) 
+		bool is_pruned = false;
+		for (size_t i = first_essential; i-- > 0;)
 		{
-			if (word_to_document_freqs_.count(word) != 0) 
+			if (score + upper_bound_prefix[i + 1] < threshold)
 			{
-				for (const auto [document_id, _] : word_to_document_freqs_.at(word)) 
-				{
-					document_to_relevance.Erase(document_id);
-				}
+				is_pruned = true;
+				break;
 			}
-		});
+			auto& cursor = cursors[i];
+			cursor.postings.SeekGE(candidate);
+			if (cursor.postings.IsValid() && cursor.postings.Get().ordinal == candidate)
+			{
+				const double contribution = cursor.postings.Get().term_count * inv_word_count * cursor.inverse_document_freq;
+				contributions[cursor.word_index] = contribution;
+				has_contribution[cursor.word_index] = true;
+				score += contribution;
+			}
+		}
+		if (is_pruned)
+		{
+			continue;
+		}
+
+		double relevance = 0.0;
+		for (size_t word_index = 0; word_index < contributions.size(); ++word_index)
+		{
+			if (has_contribution[word_index])
+			{
+				relevance += contributions[word_index];
+			}
+		}
+		top_documents.Push({ documents_.ids[candidate], relevance, documents_.ratings[candidate] });
+
+		if (top_documents.IsFull())
+		{
+			threshold = top_documents.GetWorst().relevance - EPSILON - rounding_margin;
+			while (first_essential < cursors.size() && upper_bound_prefix[first_essential + 1] < threshold)
+			{
+				++first_essential;
+			}
+		}
+	}
 
-	std::vector<Document> matched_documents;
-	std::map<int, double> result = document_to_relevance.BuildOrdinaryMap();
-	matched_documents.reserve(result.size());
+	top_documents.Extract(context.documents_);
+}
 
-	std::for_each(std::execution::par, result.begin(), result.end(), 
-		[&matched_documents, this](const auto& doc) 
+template <typename ExecutionPolicy, typename Criterion>
+std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy& policy, const Query& query, Criterion criterion,
+	size_t max_result_count) const
+{
+	std::vector<std::pair<const PostingList*, double>> plus_postings;
+	for (const auto& word : query.plus_words)
+	{
+		const int word_id = words_.Find(word);
+		if (word_id != StringInterner::NOT_FOUND)
 		{
-			matched_documents.push_back({ doc.first, doc.second, documents_.at(doc.first).rating });
+			plus_postings.push_back({ &word_postings_[word_id], GetWordInverseDocumentFreq(word_id) });
+		}
+	}
+	OrdinalBitmap excluded;
+	FillExcludedDocuments(query, excluded);
+
+	// Каждая задача владеет своим диапазоном порядковых номеров, поэтому
+	// накопители не пересекаются и синхронизация не нужна.
+	const int ordinal_count = static_cast<int>(documents_.size());
+	const int chunk_count = std::max(1, std::min(ordinal_count / 1024, static_cast<int>(GetThreadCount(policy)) * 4));
+	const int chunk_size = (ordinal_count + chunk_count - 1) / std::max(chunk_count, 1);
+
+	std::vector<TopDocuments> chunk_documents(chunk_count, TopDocuments(max_result_count));
+	ParallelFor(policy, chunk_count,
+		[&](const size_t chunk_index)
+		{
+			const int first = static_cast<int>(chunk_index) * chunk_size;
+			const int last = std::min(ordinal_count, first + chunk_size);
+			if (first >= last)
+			{
+				return;
+			}
+
+			RelevanceAccumulator accumulator;
+			accumulator.Reset(last - first);
+			{
+				PROFILE_SCOPE("search.traverse");
+				std::array<Posting, PostingList::MAX_BLOCK_SIZE> cursor_buffer;
+				for (const auto& [postings, inverse_document_freq] : plus_postings)
+				{
+					PostingList::Cursor cursor(*postings, cursor_buffer.data());
+					for (cursor.SeekGE(first); cursor.IsValid() && cursor.Get().ordinal < last; cursor.Next())
+					{
+						const auto [ordinal, term_count] = cursor.Get();
+						if (excluded.Contains(ordinal))
+						{
+							continue;
+						}
+						if (criterion(ordinal))
+						{
+							accumulator.Add(ordinal - first, term_count * documents_.inv_word_counts[ordinal] * inverse_document_freq);
+						}
+					}
+				}
+			}
+
+			PROFILE_SCOPE("search.chunk_top_k");
+			auto& top_documents = chunk_documents[chunk_index];
+			for (const int local_ordinal : accumulator.GetTouched())
+			{
+				const int ordinal = first + local_ordinal;
+				top_documents.Push({ documents_.ids[ordinal], accumulator.GetRelevance(local_ordinal), documents_.ratings[ordinal] });
+			}
 		});
 
-	return matched_documents;
-}
\ No newline at end of file
+	PROFILE_SCOPE("search.merge_top_k");
+	TopDocuments top_documents(max_result_count);
+	for (const auto& documents : chunk_documents)
+	{
+		top_documents.Merge(documents);
+	}
+	return top_documents.Extract();
+}
@@ -0,0 +1,153 @@
+#include "snapshot_search_server.h"
+#include <exception>
+#include <thread>
+
+SnapshotSearchServer::Snapshot::Snapshot(const SearchServer* server, ReadCounter* counter, uint64_t version)
+	: server_(server)
+	, counter_(counter)
+	, version_(version)
+{}
+
+SnapshotSearchServer::Snapshot::Snapshot(Snapshot&& other) noexcept
+	: server_(other.server_)
+	, counter_(other.counter_)
+	, version_(other.version_)
+{
+	other.counter_ = nullptr;
+}
+
+SnapshotSearchServer::Snapshot::~Snapshot()
+{
+	if (counter_ != nullptr)
+	{
+		counter_->value.fetch_sub(1);
+	}
+}
+
+const SearchServer& SnapshotSearchServer::Snapshot::operator*() const
+{
+	return *server_;
+}
+
+const SearchServer* SnapshotSearchServer::Snapshot::operator->() const
+{
+	return server_;
+}
+
+uint64_t SnapshotSearchServer::Snapshot::GetVersion() const
+{
+	return version_;
+}
+
+SnapshotSearchServer::SnapshotSearchServer(const std::string_view stop_words_text)
+	: instances_{ SearchServer(stop_words_text), SearchServer(stop_words_text) }
+{}
+
+SnapshotSearchServer::Snapshot SnapshotSearchServer::GetSnapshot() const
+{
+	ReadCounter& counter = read_indicators_[active_indicator_.load()][GetStripeIndex()];
+	counter.value.fetch_add(1);
+	const int active_instance = active_instance_.load();
+	return Snapshot(&instances_[active_instance], &counter, instance_versions_[active_instance]);
+}
+
+uint64_t SnapshotSearchServer::GetVersion() const
+{
+	return version_.load();
+}
+
+void SnapshotSearchServer::AddDocument(int document_id, const std::string_view document,
+	DocumentStatus status, const std::vector<int>& ratings)
+{
+	Update([&](SearchServer& server)
+		{
+			server.AddDocument(document_id, document, status, ratings);
+		});
+}
+
+void SnapshotSearchServer::RemoveDocument(int document_id)
+{
+	Update([document_id](SearchServer& server)
+		{
+			server.RemoveDocument(document_id);
+		});
+}
+
+void SnapshotSearchServer::SetPostingsCompression(bool enabled)
+{
+	Update([enabled](SearchServer& server)
+		{
+			server.SetPostingsCompression(enabled);
+		});
+}
+
+void SnapshotSearchServer::Update(const std::function<void(SearchServer&)>& update)
+{
+	std::lock_guard guard(writer_mutex_);
+
+	const int active_instance = active_instance_.load();
+	std::exception_ptr error;
+	try
+	{
+		update(instances_[1 - active_instance]);
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+
+	// Даже при исключении часть изменений могла быть применена, поэтому обе копии
+	// проходят один и тот же путь и остаются одинаковыми.
+	const uint64_t version = version_.load() + 1;
+	instance_versions_[1 - active_instance] = version;
+	active_instance_.store(1 - active_instance);
+	version_.store(version);
+
+	const int previous_indicator = active_indicator_.load();
+	const int next_indicator = 1 - previous_indicator;
+	while (!IsEmpty(read_indicators_[next_indicator]))
+	{
+		std::this_thread::yield();
+	}
+	active_indicator_.store(next_indicator);
+	while (!IsEmpty(read_indicators_[previous_indicator]))
+	{
+		std::this_thread::yield();
+	}
+
+	try
+	{
+		update(instances_[active_instance]);
+	}
+	catch (...)
+	{
+		if (!error)
+		{
+			error = std::current_exception();
+		}
+	}
+	instance_versions_[active_instance] = version;
+
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+}
+
+size_t SnapshotSearchServer::GetStripeIndex()
+{
+	static thread_local const size_t stripe_index = std::hash<std::thread::id>()(std::this_thread::get_id()) % READ_INDICATOR_STRIPES;
+	return stripe_index;
+}
+
+bool SnapshotSearchServer::IsEmpty(const ReadIndicator& indicator)
+{
+	for (const ReadCounter& counter : indicator)
+	{
+		if (counter.value.load() != 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
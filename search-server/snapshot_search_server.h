@@ -0,0 +1,94 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include "search_server.h"
+
+// Поисковый сервер для одновременного чтения и обновления индекса.
+//
+// Используется схема Left-Right: хранятся две копии SearchServer. Читатели
+// работают с активной копией и лишь отмечаются в счётчике читателей, без
+// блокировок. Писатель применяет изменение к неактивной копии, публикует её,
+// дожидается ухода читателей старой копии и повторяет то же изменение на ней.
+// Поэтому читатель всегда видит согласованное состояние индекса, а изменения
+// становятся видимыми целиком.
+class SnapshotSearchServer
+{
+private:
+
+	static const size_t READ_INDICATOR_STRIPES = 16;
+
+	struct alignas(64) ReadCounter
+	{
+		std::atomic<int64_t> value{ 0 };
+	};
+
+	using ReadIndicator = std::array<ReadCounter, READ_INDICATOR_STRIPES>;
+
+public:
+
+	// Неизменяемое представление индекса. Пока объект жив, писатели не изменяют
+	// видимую через него копию, поэтому долго удерживать его не следует.
+	class Snapshot
+	{
+	public:
+
+		Snapshot(const Snapshot&) = delete;
+		Snapshot& operator=(const Snapshot&) = delete;
+		Snapshot(Snapshot&& other) noexcept;
+		Snapshot& operator=(Snapshot&&) = delete;
+		~Snapshot();
+
+		const SearchServer& operator*() const;
+
+		const SearchServer* operator->() const;
+
+		uint64_t GetVersion() const;
+
+	private:
+
+		friend class SnapshotSearchServer;
+
+		Snapshot(const SearchServer* server, ReadCounter* counter, uint64_t version);
+
+		const SearchServer* server_;
+		ReadCounter* counter_;
+		uint64_t version_;
+	};
+
+	explicit SnapshotSearchServer(const std::string_view stop_words_text);
+
+	Snapshot GetSnapshot() const;
+
+	uint64_t GetVersion() const;
+
+	void AddDocument(int document_id, const std::string_view document,
+		DocumentStatus status, const std::vector<int>& ratings);
+
+	void RemoveDocument(int document_id);
+
+	void SetPostingsCompression(bool enabled);
+
+	// Применяет набор изменений и публикует их одной новой версией. Функция
+	// вызывается дважды, по разу для каждой копии, и должна быть детерминированной.
+	void Update(const std::function<void(SearchServer&)>& update);
+
+private:
+
+	static size_t GetStripeIndex();
+
+	static bool IsEmpty(const ReadIndicator& indicator);
+
+	std::array<SearchServer, 2> instances_;
+	std::array<uint64_t, 2> instance_versions_{ 0, 0 };
+	mutable std::array<ReadIndicator, 2> read_indicators_;
+	std::atomic<int> active_instance_{ 0 };
+	std::atomic<int> active_indicator_{ 0 };
+	std::atomic<uint64_t> version_{ 0 };
+	std::mutex writer_mutex_;
+};
@@ -0,0 +1,227 @@
+#include "string_interner.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+int StringInterner::Intern(std::string_view str)
+{
+	const size_t hash = std::hash<std::string_view>()(str);
+	const size_t slot = FindSlot(str, hash);
+	if (slot != slots_.size())
+	{
+		return slots_[slot];
+	}
+	return Insert(str, hash, true);
+}
+
+int StringInterner::InternExternal(std::string_view str)
+{
+	const size_t hash = std::hash<std::string_view>()(str);
+	const size_t slot = FindSlot(str, hash);
+	if (slot != slots_.size())
+	{
+		return slots_[slot];
+	}
+	return Insert(str, hash, false);
+}
+
+int StringInterner::Find(std::string_view str) const
+{
+	const size_t slot = FindSlot(str, std::hash<std::string_view>()(str));
+	return slot == slots_.size() ? NOT_FOUND : slots_[slot];
+}
+
+std::string_view StringInterner::Get(int id) const
+{
+	return entries_[id].str;
+}
+
+void StringInterner::Release(int id)
+{
+	const Entry& entry = entries_[id];
+	slots_[FindSlot(entry.str, entry.hash)] = DELETED_SLOT;
+	--size_;
+	if (size_ == 0)
+	{
+		// Пустое хранилище возвращает всю память.
+		*this = StringInterner();
+		return;
+	}
+
+	if (entry.chunk != EXTERNAL_CHUNK)
+	{
+		Chunk& chunk = chunks_[entry.chunk];
+		if (--chunk.live_count == 0)
+		{
+			if (entry.chunk == current_chunk_)
+			{
+				chunk.used = 0;
+			}
+			else
+			{
+				chunk = Chunk();
+				free_chunks_.push_back(entry.chunk);
+			}
+		}
+	}
+	entries_[id] = { std::string_view(), 0, EXTERNAL_CHUNK };
+	free_ids_.push_back(id);
+}
+
+size_t StringInterner::size() const
+{
+	return size_;
+}
+
+bool StringInterner::empty() const
+{
+	return size_ == 0;
+}
+
+size_t StringInterner::GetIdBound() const
+{
+	return entries_.size();
+}
+
+size_t StringInterner::GetMemoryUsage() const
+{
+	size_t usage = entries_.capacity() * sizeof(Entry)
+		+ free_ids_.capacity() * sizeof(int)
+		+ slots_.capacity() * sizeof(int32_t)
+		+ chunks_.capacity() * sizeof(Chunk)
+		+ free_chunks_.capacity() * sizeof(int);
+	for (const Chunk& chunk : chunks_)
+	{
+		usage += chunk.capacity;
+	}
+	return usage;
+}
+
+int StringInterner::Insert(std::string_view str, size_t hash, bool copy)
+{
+	if ((used_slot_count_ + 1) * 2 > slots_.size())
+	{
+		Rehash(std::max<size_t>(16, (size_ + 1) * 4));
+	}
+
+	int chunk_index = EXTERNAL_CHUNK;
+	if (copy)
+	{
+		str = Allocate(str, chunk_index);
+	}
+
+	int id;
+	if (free_ids_.empty())
+	{
+		id = static_cast<int>(entries_.size());
+		entries_.push_back({ str, hash, chunk_index });
+	}
+	else
+	{
+		id = free_ids_.back();
+		free_ids_.pop_back();
+		entries_[id] = { str, hash, chunk_index };
+	}
+
+	size_t slot = hash & (slots_.size() - 1);
+	while (slots_[slot] >= 0)
+	{
+		slot = (slot + 1) & (slots_.size() - 1);
+	}
+	if (slots_[slot] == EMPTY_SLOT)
+	{
+		++used_slot_count_;
+	}
+	slots_[slot] = id;
+	++size_;
+	return id;
+}
+
+std::string_view StringInterner::Allocate(std::string_view str, int& chunk_index)
+{
+	// Длинная строка получает отдельный блок, чтобы не дробить обычные.
+	const bool is_oversized = str.size() > CHUNK_SIZE;
+	if (is_oversized || current_chunk_ < 0 || chunks_[current_chunk_].capacity - chunks_[current_chunk_].used < str.size())
+	{
+		int new_chunk;
+		if (free_chunks_.empty())
+		{
+			new_chunk = static_cast<int>(chunks_.size());
+			chunks_.emplace_back();
+		}
+		else
+		{
+			new_chunk = free_chunks_.back();
+			free_chunks_.pop_back();
+		}
+		Chunk& chunk = chunks_[new_chunk];
+		chunk.capacity = std::max(CHUNK_SIZE, str.size());
+		chunk.data.reset(new char[chunk.capacity]);
+
+		if (is_oversized)
+		{
+			chunk_index = new_chunk;
+		}
+		else
+		{
+			current_chunk_ = new_chunk;
+			chunk_index = current_chunk_;
+		}
+	}
+	else
+	{
+		chunk_index = current_chunk_;
+	}
+
+	Chunk& chunk = chunks_[chunk_index];
+	char* data = chunk.data.get() + chunk.used;
+	std::memcpy(data, str.data(), str.size());
+	chunk.used += str.size();
+	++chunk.live_count;
+	return std::string_view(data, str.size());
+}
+
+size_t StringInterner::FindSlot(std::string_view str, size_t hash) const
+{
+	if (slots_.empty())
+	{
+		return slots_.size();
+	}
+	const size_t mask = slots_.size() - 1;
+	for (size_t slot = hash & mask;; slot = (slot + 1) & mask)
+	{
+		const int32_t id = slots_[slot];
+		if (id == EMPTY_SLOT)
+		{
+			return slots_.size();
+		}
+		if (id >= 0 && entries_[id].hash == hash && entries_[id].str == str)
+		{
+			return slot;
+		}
+	}
+}
+
+void StringInterner::Rehash(size_t slot_count)
+{
+	size_t capacity = 1;
+	while (capacity < slot_count)
+	{
+		capacity <<= 1;
+	}
+	std::vector<int32_t> slots(capacity, EMPTY_SLOT);
+	for (const int32_t id : slots_)
+	{
+		if (id >= 0)
+		{
+			size_t slot = entries_[id].hash & (capacity - 1);
+			while (slots[slot] != EMPTY_SLOT)
+			{
+				slot = (slot + 1) & (capacity - 1);
+			}
+			slots[slot] = id;
+		}
+	}
+	slots_ = std::move(slots);
+	used_slot_count_ = size_;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Хранилище уникальных строк с плотными целочисленными номерами.
+//
+// Символы копируются в крупные блоки (арену), номер по строке ищется в
+// хеш-таблице с открытой адресацией. Номера освобождённых строк переиспользуются,
+// блок освобождается целиком, когда в нём не остаётся живых строк. Строки не
+// перемещаются, поэтому string_view на них действительны до освобождения строки,
+// в том числе после перемещения самого хранилища.
+class StringInterner
+{
+public:
+
+	static constexpr int NOT_FOUND = -1;
+	static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+	StringInterner() = default;
+	StringInterner(const StringInterner&) = delete;
+	StringInterner& operator=(const StringInterner&) = delete;
+	StringInterner(StringInterner&&) = default;
+	StringInterner& operator=(StringInterner&&) = default;
+
+	// Возвращает номер строки, копируя её в арену, если строки ещё нет.
+	int Intern(std::string_view str);
+
+	// То же без копирования: память строки должна жить дольше хранилища.
+	int InternExternal(std::string_view str);
+
+	int Find(std::string_view str) const;
+
+	std::string_view Get(int id) const;
+
+	void Release(int id);
+
+	size_t size() const;
+
+	bool empty() const;
+
+	// Все живые номера меньше этой границы.
+	size_t GetIdBound() const;
+
+	size_t GetMemoryUsage() const;
+
+private:
+
+	static constexpr int32_t EMPTY_SLOT = -1;
+	static constexpr int32_t DELETED_SLOT = -2;
+	static constexpr int EXTERNAL_CHUNK = -1;
+
+	struct Entry
+	{
+		std::string_view str;
+		size_t hash;
+		int chunk;
+	};
+
+	struct Chunk
+	{
+		std::unique_ptr<char[]> data;
+		size_t capacity = 0;
+		size_t used = 0;
+		size_t live_count = 0;
+	};
+
+	int Insert(std::string_view str, size_t hash, bool copy);
+
+	std::string_view Allocate(std::string_view str, int& chunk_index);
+
+	size_t FindSlot(std::string_view str, size_t hash) const;
+
+	void Rehash(size_t slot_count);
+
+	std::vector<Entry> entries_;
+	std::vector<int> free_ids_;
+	std::vector<int32_t> slots_;
+	size_t used_slot_count_ = 0;
+	size_t size_ = 0;
+	std::vector<Chunk> chunks_;
+	std::vector<int> free_chunks_;
+	int current_chunk_ = -1;
+};
@@ -1,18 +1,128 @@
 #include "string_processing.h"
 #include <algorithm>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SEARCH_SERVER_USE_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+	bool IsControlCharacter(char c)
+	{
+		return static_cast<unsigned char>(c) < 32;
+	}
+
+#ifdef SEARCH_SERVER_USE_SSE2
+	const size_t SIMD_BLOCK_SIZE = 16;
+
+	unsigned CountTrailingZeros(unsigned value)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, value);
+		return index;
+#else
+		return __builtin_ctz(value);
+#endif
+	}
+
+	// Маска байтов с кодами 0-31: для них min(byte, 31) == byte без учёта знака.
+	__m128i FindControlCharacters(__m128i block)
+	{
+		return _mm_cmpeq_epi8(_mm_min_epu8(block, _mm_set1_epi8(31)), block);
+	}
+#endif
+}
+
+bool SplitIntoWords(std::string_view text, std::vector<std::string_view>& words)
+{
+	words.clear();
+	const char* data = text.data();
+	const size_t size = text.size();
+	size_t word_start = 0;
+	bool in_word = false;
+	bool has_control_characters = false;
+	size_t pos = 0;
+
+#ifdef SEARCH_SERVER_USE_SSE2
+	// За один проход по блоку находятся и границы слов, и управляющие символы.
+	// Бит маски transitions установлен там, где меняется признак «внутри слова».
+	const __m128i spaces = _mm_set1_epi8(' ');
+	__m128i control_characters = _mm_setzero_si128();
+	for (; pos + SIMD_BLOCK_SIZE <= size; pos += SIMD_BLOCK_SIZE)
+	{
+		const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+		control_characters = _mm_or_si128(control_characters, FindControlCharacters(block));
+		const unsigned non_spaces = ~static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, spaces))) & 0xFFFF;
+		unsigned transitions = (non_spaces ^ ((non_spaces << 1) | (in_word ? 1u : 0u))) & 0xFFFF;
+		while (transitions != 0)
+		{
+			const size_t offset = pos + CountTrailingZeros(transitions);
+			if (in_word)
+			{
+				words.emplace_back(data + word_start, offset - word_start);
+			}
+			else
+			{
+				word_start = offset;
+			}
+			in_word = !in_word;
+			transitions &= transitions - 1;
+		}
+	}
+	has_control_characters = _mm_movemask_epi8(control_characters) != 0;
+#endif
+
+	for (; pos < size; ++pos)
+	{
+		const char c = data[pos];
+		has_control_characters |= IsControlCharacter(c);
+		if ((c != ' ') != in_word)
+		{
+			if (in_word)
+			{
+				words.emplace_back(data + word_start, pos - word_start);
+			}
+			else
+			{
+				word_start = pos;
+			}
+			in_word = !in_word;
+		}
+	}
+	if (in_word)
+	{
+		words.emplace_back(data + word_start, size - word_start);
+	}
+	return !has_control_characters;
+}
 
 std::vector<std::string_view> SplitIntoWords(std::string_view text)
 {
 	std::vector<std::string_view> result;
-	text.remove_prefix(std::min(text.find_first_not_of(" "), text.size()));
-	const int64_t pos_end = text.npos;
+	SplitIntoWords(text, result);
+	return result;
+}
 
-	while (!text.empty()) {
-		int64_t space = text.find(' ');
-		result.push_back(text.substr(0, space));
-		text.remove_prefix(space == pos_end ? text.size() : space);
-		text.remove_prefix(std::min(text.find_first_not_of(" "), text.size()));
+bool HasControlCharacters(std::string_view text)
+{
+	size_t pos = 0;
+#ifdef SEARCH_SERVER_USE_SSE2
+	__m128i control_characters = _mm_setzero_si128();
+	for (; pos + SIMD_BLOCK_SIZE <= text.size(); pos += SIMD_BLOCK_SIZE)
+	{
+		const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + pos));
+		control_characters = _mm_or_si128(control_characters, FindControlCharacters(block));
 	}
-	return result;
-}
\ No newline at end of file
+	if (_mm_movemask_epi8(control_characters) != 0)
+	{
+		return true;
+	}
+#endif
+	return std::any_of(text.begin() + pos, text.end(), IsControlCharacter);
+}
@@ -7,6 +7,13 @@
 
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
 
+// Разбивает текст на слова по пробелам в переданный буфер, переиспользуя его память.
+// В том же проходе проверяет символы: возвращает false, если в тексте есть
+// управляющие символы с кодами 0-31. На x86 блоки по 16 байт обрабатываются SSE2.
+bool SplitIntoWords(std::string_view text, std::vector<std::string_view>& words);
+
+bool HasControlCharacters(std::string_view text);
+
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings)
 {
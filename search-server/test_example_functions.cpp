@@ -1,11 +1,75 @@
 #include "test_example_functions.h"
+#include <execution>
+#include <numeric>
 #include <tuple>
 #include <vector>
 #include "document.h"
 #include "search_server.h"
+#include "concurrent_map.h"
+#include "snapshot_search_server.h"
+#include "process_queries.h"
+#include "string_interner.h"
+#include "ordinal_bitmap.h"
+#include "thread_pool.h"
+#include "remove_duplicates.h"
+#include "near_duplicates.h"
+#include "paginator.h"
+#include "request_queue.h"
+#include "profiler.h"
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
 
 using namespace std;
 
+#ifdef SEARCH_SERVER_COUNT_ALLOCATIONS
+// Подсчёт выделений памяти для TestQueryContextAvoidsAllocations. Замена глобального
+// operator new действует на всю программу, поэтому включается только в тестовой
+// сборке с -DSEARCH_SERVER_COUNT_ALLOCATIONS; без флага тест не проверяет число выделений.
+namespace
+{
+	// Число выделений памяти в текущем потоке, считается заменённым operator new.
+	thread_local size_t allocation_count = 0;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+// Замена operator new видна компилятору вместе с operator delete.
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size)
+{
+	++allocation_count;
+	if (void* data = std::malloc(size == 0 ? 1 : size))
+	{
+		return data;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* data) noexcept
+{
+	std::free(data);
+}
+
+void operator delete(void* data, size_t) noexcept
+{
+	std::free(data);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
 void AssertImpl(bool value, const std::string& raw_value, const int line, const std::string& file,
 	const std::string& func, const std::string& hint)
 {
@@ -85,7 +149,7 @@ void TestMatchingDocumentsWithQuery()
 		SearchServer server;
 		server.SetStopWords("the of"s);
 		server.AddDocument(doc_id, content, DocumentStatus::ACTUAL, ratings);
-		std::vector<std::string_view> matched_words = { "loneliest"s, "most"s };
+		std::vector<std::string_view> matched_words = { "loneliest"sv, "most"sv };
 		ASSERT(server.MatchDocument("the most loneliest week"s, 13) == std::tuple(matched_words, DocumentStatus::ACTUAL));
 		matched_words.clear();
 		ASSERT(server.MatchDocument("the most -loneliest week"s, 13) == std::tuple(matched_words, DocumentStatus::ACTUAL));
@@ -179,6 +243,1427 @@ void TestTfIdfComputing()
 	ASSERT(abs(result.front().relevance - 0.866434) < 1e-6);
 }
 
+void TestTfIdfStaysCurrentAfterUpdates()
+{
+	SearchServer search_server("и в на"s);
+	// Слова документов без стоп-слов: по ним tf и idf считаются независимо от сервера.
+	std::map<int, std::vector<std::string>> documents;
+	const std::vector<std::string> words = { "кот"s, "пёс"s, "хвост"s, "ошейник"s, "скворец"s };
+	const auto make_words = [&words](int id)
+		{
+			std::vector<std::string> document_words;
+			for (int i = 0; i < 2 + id % 4; ++i)
+			{
+				document_words.push_back(words[(id * 3 + i * (id % 3 + 1)) % words.size()]);
+			}
+			return document_words;
+		};
+	const auto join = [](const std::vector<std::string>& document_words)
+		{
+			std::string text = "и"s;
+			for (const std::string& word : document_words)
+			{
+				text += " "s + word;
+			}
+			return text;
+		};
+	const auto check_relevance = [&]()
+		{
+			for (const std::string& query : { "кот"s, "пёс хвост"s, "кот скворец ошейник"s })
+			{
+				const std::vector<std::string_view> query_words = SplitIntoWords(query);
+				std::map<int, double> expected;
+				for (const std::string_view word : query_words)
+				{
+					int document_freq = 0;
+					for (const auto& [id, document_words] : documents)
+					{
+						document_freq += std::count(document_words.begin(), document_words.end(), word) > 0 ? 1 : 0;
+					}
+					if (document_freq == 0)
+					{
+						continue;
+					}
+					const double idf = std::log(static_cast<double>(documents.size()) / document_freq);
+					for (const auto& [id, document_words] : documents)
+					{
+						const auto term_count = std::count(document_words.begin(), document_words.end(), word);
+						if (term_count > 0)
+						{
+							expected[id] += static_cast<double>(term_count) / document_words.size() * idf;
+						}
+					}
+				}
+				const auto result = search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 1000);
+				ASSERT_EQUAL(result.size(), expected.size());
+				for (const Document& document : result)
+				{
+					ASSERT(expected.count(document.id) > 0);
+					ASSERT(std::abs(document.relevance - expected.at(document.id)) < 1e-6);
+				}
+			}
+		};
+
+	for (int id = 0; id < 20; ++id)
+	{
+		documents[id] = make_words(id);
+		search_server.AddDocument(id, join(documents[id]), DocumentStatus::ACTUAL, { id });
+	}
+	check_relevance();
+
+	search_server.RemoveDocument(3);
+	search_server.RemoveDocument(std::execution::seq, 4);
+	search_server.RemoveDocument(std::execution::par, 5);
+	for (const int id : { 3, 4, 5 })
+	{
+		documents.erase(id);
+	}
+	check_relevance();
+
+	search_server.RemoveDocuments(std::execution::seq, { 6, 7 });
+	search_server.RemoveDocuments(std::execution::par, { 8, 9, 10 });
+	for (const int id : { 6, 7, 8, 9, 10 })
+	{
+		documents.erase(id);
+	}
+	check_relevance();
+
+	std::vector<std::string> texts;
+	std::vector<SearchServer::NewDocument> batch;
+	for (int id = 20; id < 30; ++id)
+	{
+		texts.push_back(join(make_words(id)));
+	}
+	for (int id = 20; id < 30; ++id)
+	{
+		batch.push_back({ id, texts[id - 20], DocumentStatus::ACTUAL, { id } });
+	}
+	search_server.AddDocuments(std::execution::seq, { batch.begin(), batch.begin() + 5 });
+	for (int id = 20; id < 25; ++id)
+	{
+		documents[id] = make_words(id);
+	}
+	check_relevance();
+	search_server.AddDocuments(std::execution::par, { batch.begin() + 5, batch.end() });
+	for (int id = 25; id < 30; ++id)
+	{
+		documents[id] = make_words(id);
+	}
+	check_relevance();
+}
+
+void TestAddingAndRemovingDocumentsInAnyOrder()
+{
+	SearchServer search_server;
+	search_server.SetStopWords("и в на"s);
+	search_server.AddDocument(7, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+	search_server.AddDocument(2, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, { 8, -3 });
+	search_server.AddDocument(5, "ухоженный кот"s, DocumentStatus::ACTUAL, { 1 });
+
+	ASSERT_EQUAL(search_server.FindTopDocuments("кот"s).size(), 3);
+	ASSERT_EQUAL(std::get<0>(search_server.MatchDocument("кот хвост"s, 7)).size(), 2);
+
+	search_server.RemoveDocument(5);
+	search_server.RemoveDocument(std::execution::par, 7);
+	const auto result = search_server.FindTopDocuments("кот хвост ухоженный"s);
+	ASSERT_EQUAL(result.size(), 1);
+	ASSERT_EQUAL(result.front().id, 2);
+	ASSERT_EQUAL(search_server.GetDocumentCount(), 1);
+}
+
+void TestParallelSearchMatchesSequential()
+{
+	SearchServer search_server("и в на"s);
+	const std::vector<std::string> words = { "кот"s, "пёс"s, "хвост"s, "ошейник"s, "белый"s, "пушистый"s, "модный"s };
+	for (int id = 0; id < 3000; ++id)
+	{
+		std::string text;
+		for (int i = 0; i <= id % 5; ++i)
+		{
+			text += words[(id * 7 + i * 3) % words.size()] + " "s;
+		}
+		search_server.AddDocument(id, text, DocumentStatus::ACTUAL, { id });
+	}
+	for (int id = 0; id < 3000; id += 4)
+	{
+		search_server.RemoveDocument(id);
+	}
+	search_server.AddDocument(5000, "пушистый белый кот"s, DocumentStatus::ACTUAL, { 5000 });
+
+	for (const std::string& query : { "кот"s, "пушистый кот -хвост"s, "модный пёс ошейник"s })
+	{
+		ASSERT_EQUAL(search_server.FindTopDocuments(std::execution::par, query), search_server.FindTopDocuments(query));
+	}
+}
+
+void TestFindingTopDocumentsWithCustomResultCount()
+{
+	SearchServer search_server("и в на"s);
+	for (int id = 0; id < 20; ++id)
+	{
+		search_server.AddDocument(id, "кот"s + std::string(id % 3, ' ') + " хвост"s, DocumentStatus::ACTUAL, { id % 4 });
+	}
+	search_server.AddDocument(20, "пушистый кот"s, DocumentStatus::BANNED, { 1 });
+
+	const auto top_three = search_server.FindTopDocuments("кот"s, DocumentStatus::ACTUAL, 3);
+	ASSERT_EQUAL(top_three.size(), 3);
+	const auto all_documents = search_server.FindTopDocuments("кот"s, DocumentStatus::ACTUAL, 100);
+	ASSERT_EQUAL(all_documents.size(), 20);
+	ASSERT_EQUAL(std::vector<Document>(all_documents.begin(), all_documents.begin() + 3), top_three);
+	for (size_t i = 1; i < all_documents.size(); ++i)
+	{
+		ASSERT(!(all_documents[i] > all_documents[i - 1]));
+	}
+	ASSERT_EQUAL(search_server.FindTopDocuments(std::execution::par, "кот"s, DocumentStatus::ACTUAL, 7),
+		std::vector<Document>(all_documents.begin(), all_documents.begin() + 7));
+	ASSERT_EQUAL(search_server.FindTopDocuments(std::execution::par, "кот"s, DocumentStatus::BANNED).size(), 1);
+	ASSERT(search_server.FindTopDocuments("кот"s, DocumentStatus::ACTUAL, 0).empty());
+}
+
+void TestPrunedTopDocumentsMatchExhaustiveSearch()
+{
+	SearchServer search_server("и в на"s);
+	const std::vector<std::string> words = { "кот"s, "пёс"s, "хвост"s, "ошейник"s, "белый"s, "пушистый"s, "модный"s, "скворец"s };
+	for (int id = 0; id < 2000; ++id)
+	{
+		std::string text;
+		const int word_count = 1 + id % 9;
+		for (int i = 0; i < word_count; ++i)
+		{
+			text += words[(id / (i + 1) + i * i) % words.size()] + " "s;
+		}
+		search_server.AddDocument(id, text, DocumentStatus(id % 3), { id % 11, id % 7 });
+	}
+
+	const auto even_ids = [](int document_id, DocumentStatus, int)
+		{
+			return document_id % 2 == 0;
+		};
+	for (const std::string& query : { "кот пёс хвост"s, "белый пушистый модный скворец -ошейник"s, "кот ошейник скворец пёс хвост"s })
+	{
+		for (const size_t max_result_count : { 1, 5, 40 })
+		{
+			ASSERT_EQUAL(search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, max_result_count),
+				search_server.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL, max_result_count));
+			ASSERT_EQUAL(search_server.FindTopDocuments(query, even_ids, max_result_count),
+				search_server.FindTopDocuments(std::execution::par, query, even_ids, max_result_count));
+		}
+	}
+}
+
+void TestCompressedPostingsGiveSameResults()
+{
+	SearchServer plain_server("и в на"s);
+	SearchServer compressed_server("и в на"s);
+	compressed_server.SetPostingsCompression(true);
+	const std::vector<std::string> words = { "кот"s, "пёс"s, "хвост"s, "ошейник"s, "белый"s, "пушистый"s, "модный"s, "скворец"s };
+	for (int id = 0; id < 1500; ++id)
+	{
+		std::string text;
+		for (int i = 0; i <= id % 6; ++i)
+		{
+			text += words[(id / (i + 1) + i) % words.size()] + " "s;
+		}
+		plain_server.AddDocument(id, text, DocumentStatus::ACTUAL, { id % 13 });
+		compressed_server.AddDocument(id, text, DocumentStatus::ACTUAL, { id % 13 });
+	}
+	for (int id = 0; id < 1500; id += 7)
+	{
+		plain_server.RemoveDocument(id);
+		compressed_server.RemoveDocument(id);
+	}
+
+	for (const std::string& query : { "кот"s, "пушистый скворец -ошейник"s, "модный пёс белый хвост"s })
+	{
+		ASSERT_EQUAL(compressed_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 20),
+			plain_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 20));
+		ASSERT_EQUAL(compressed_server.FindTopDocuments(std::execution::par, query),
+			plain_server.FindTopDocuments(query));
+	}
+	ASSERT(compressed_server.MatchDocument("кот пёс"s, 1) == plain_server.MatchDocument("кот пёс"s, 1));
+	ASSERT(compressed_server.GetMemoryUsage().postings < plain_server.GetMemoryUsage().postings);
+
+	plain_server.SetPostingsCompression(true);
+	ASSERT_EQUAL(plain_server.FindTopDocuments("кот хвост"s), compressed_server.FindTopDocuments("кот хвост"s));
+}
+
+void TestCompressedPostingsUpdateInMiddle()
+{
+	PostingList plain;
+	PostingList compressed;
+	compressed.SetCompressed(true);
+	const auto add = [&](int ordinal, int term_count)
+		{
+			plain.Add(ordinal, term_count, 0.1);
+			compressed.Add(ordinal, term_count, 0.1);
+		};
+	const auto to_vector = [](const PostingList& postings)
+		{
+			std::vector<std::pair<int, int>> result;
+			for (PostingList::Cursor cursor(postings); cursor.IsValid(); cursor.Next())
+			{
+				result.push_back({ cursor.Get().ordinal, cursor.Get().term_count });
+			}
+			return result;
+		};
+
+	for (int ordinal = 0; ordinal < 3000; ordinal += 2)
+	{
+		add(ordinal, 1);
+	}
+	// Вставки и удаления в середине: переполнение, деление и слияние блоков.
+	for (int ordinal = 1; ordinal < 1200; ordinal += 2)
+	{
+		add(ordinal, 2);
+	}
+	add(400, 5);
+	for (int ordinal = 1500; ordinal < 2500; ++ordinal)
+	{
+		ASSERT_EQUAL(plain.Erase(ordinal), compressed.Erase(ordinal));
+	}
+	ASSERT(!compressed.Erase(1501));
+	std::vector<bool> removed_ordinals(3000, false);
+	for (int ordinal = 0; ordinal < 3000; ordinal += 3)
+	{
+		removed_ordinals[ordinal] = true;
+	}
+	plain.Erase(removed_ordinals);
+	compressed.Erase(removed_ordinals);
+	for (int ordinal = 1500; ordinal < 2500; ordinal += 5)
+	{
+		add(ordinal, 3);
+	}
+
+	ASSERT(compressed.IsCompressed());
+	ASSERT_EQUAL(compressed.size(), plain.size());
+	ASSERT(to_vector(compressed) == to_vector(plain));
+	std::vector<bool> is_present(3001, false);
+	for (const auto& [ordinal, term_count] : to_vector(plain))
+	{
+		is_present[ordinal] = true;
+	}
+	for (int ordinal = -1; ordinal < 3001; ++ordinal)
+	{
+		const bool expected = ordinal >= 0 && is_present[ordinal];
+		ASSERT_EQUAL(plain.Contains(ordinal), expected);
+		ASSERT_EQUAL(compressed.Contains(ordinal), expected);
+	}
+	std::array<Posting, PostingList::MAX_BLOCK_SIZE> cursor_buffer;
+	for (int ordinal = 0; ordinal < 3000; ordinal += 37)
+	{
+		PostingList::Cursor cursor(compressed, cursor_buffer.data());
+		cursor.SeekGE(ordinal);
+		PostingList::Cursor plain_cursor(plain);
+		plain_cursor.SeekGE(ordinal);
+		ASSERT_EQUAL(cursor.IsValid(), plain_cursor.IsValid());
+		if (cursor.IsValid())
+		{
+			ASSERT_EQUAL(cursor.Get().ordinal, plain_cursor.Get().ordinal);
+		}
+	}
+	ASSERT(compressed.GetMemoryUsage() < plain.GetMemoryUsage());
+}
+
+void TestConcurrentMapAccumulatesInParallel()
+{
+	ConcurrentMap<int, double> relevances(1000);
+	std::vector<int> keys(100000);
+	std::iota(keys.begin(), keys.end(), 0);
+	std::for_each(std::execution::par, keys.begin(), keys.end(), [&relevances](int key)
+		{
+			relevances[key % 1000].ref_to_value += 0.5;
+			relevances.Add(key % 1000, 0.5);
+		});
+	relevances.Erase(7);
+
+	const auto result = relevances.BuildSortedVector();
+	ASSERT_EQUAL(result.size(), 999);
+	ASSERT(std::is_sorted(result.begin(), result.end()));
+	ASSERT(std::all_of(result.begin(), result.end(), [](const auto& key_value)
+		{
+			return key_value.first != 7 && std::abs(key_value.second - 100.0) < EPSILON;
+		}));
+
+	relevances[7].ref_to_value += 2.0;
+	ASSERT(std::abs(relevances.BuildOrdinaryMap().at(7) - 2.0) < EPSILON);
+
+	// Ключи сверх ёмкости таблицы уходят в корзины, а не теряются.
+	ConcurrentMap<int, int> counts(4, 10);
+	std::for_each(std::execution::par, keys.begin(), keys.end(), [&counts](int key)
+		{
+			counts.Add(key % 500, 1);
+		});
+	counts.Erase(0);
+	counts.Erase(499);
+	const auto count_pairs = counts.BuildSortedVector();
+	ASSERT_EQUAL(count_pairs.size(), 498);
+	ASSERT(std::is_sorted(count_pairs.begin(), count_pairs.end()));
+	ASSERT(std::all_of(count_pairs.begin(), count_pairs.end(), [](const auto& key_value)
+		{
+			return key_value.first != 0 && key_value.first != 499 && key_value.second == 200;
+		}));
+}
+
+void TestSnapshotReadsDuringUpdates()
+{
+	SnapshotSearchServer search_server("и в на"sv);
+	search_server.AddDocument(0, "белый кот"s, DocumentStatus::ACTUAL, { 1 });
+
+	std::atomic<bool> is_writing = true;
+	std::atomic<int> inconsistent_reads = 0;
+	std::vector<std::thread> readers;
+	for (int i = 0; i < 4; ++i)
+	{
+		readers.emplace_back([&]()
+			{
+				while (is_writing)
+				{
+					const auto snapshot = search_server.GetSnapshot();
+					const auto documents = snapshot->FindTopDocuments("кот"s, DocumentStatus::ACTUAL, 1000);
+					// Документы добавляются и удаляются парами, каждый содержит слово «кот».
+					if (static_cast<int>(documents.size()) != snapshot->GetDocumentCount() || documents.size() % 2 != 1)
+					{
+						++inconsistent_reads;
+					}
+				}
+			});
+	}
+
+	for (int id = 1; id < 400; id += 2)
+	{
+		search_server.Update([id](SearchServer& server)
+			{
+				server.AddDocument(id, "пушистый кот"s, DocumentStatus::ACTUAL, { 2 });
+				server.AddDocument(id + 1, "модный кот"s, DocumentStatus::ACTUAL, { 3 });
+			});
+		if (id % 10 == 1)
+		{
+			search_server.Update([id](SearchServer& server)
+				{
+					server.RemoveDocument(id);
+					server.RemoveDocument(id + 1);
+				});
+		}
+	}
+	is_writing = false;
+	for (auto& reader : readers)
+	{
+		reader.join();
+	}
+
+	ASSERT_EQUAL(inconsistent_reads.load(), 0);
+	ASSERT_EQUAL(search_server.GetSnapshot()->GetDocumentCount(), 321);
+	ASSERT_EQUAL(ProcessQueries(search_server, { "кот"s, "пушистый"s }).size(), 2);
+
+	bool is_thrown = false;
+	try
+	{
+		search_server.AddDocument(0, "кот"s, DocumentStatus::ACTUAL, {});
+	}
+	catch (const std::invalid_argument&)
+	{
+		is_thrown = true;
+	}
+	ASSERT(is_thrown);
+	ASSERT_EQUAL(search_server.GetSnapshot()->GetDocumentCount(), 321);
+}
+
+void TestRemovingDocumentsReclaimsWords()
+{
+	SearchServer search_server("и в на"s);
+	const auto empty_usage = search_server.GetMemoryUsage();
+	for (int id = 0; id < 300; ++id)
+	{
+		search_server.AddDocument(id, "кот"s + std::to_string(id) + " пёс хвост"s, DocumentStatus::ACTUAL, { id });
+	}
+	search_server.AddDocument(1000, "белый кот"s, DocumentStatus::ACTUAL, { 1 });
+
+	std::vector<int> removed_ids;
+	for (int id = 0; id < 300; id += 3)
+	{
+		removed_ids.push_back(id);
+	}
+	removed_ids.push_back(100500);
+	search_server.RemoveDocuments(std::execution::par, removed_ids);
+	ASSERT_EQUAL(search_server.GetDocumentCount(), 201);
+	ASSERT(search_server.FindTopDocuments("кот0 кот3"s).empty());
+	ASSERT_EQUAL(search_server.FindTopDocuments("кот1"s).size(), 1);
+	ASSERT_EQUAL(search_server.FindTopDocuments("пёс"s, DocumentStatus::ACTUAL, 1000).size(), 200);
+
+	std::vector<int> remaining_ids(search_server.begin(), search_server.end());
+	remaining_ids.pop_back();
+	search_server.RemoveDocuments(remaining_ids);
+	search_server.RemoveDocument(std::execution::par, 1000);
+	ASSERT_EQUAL(search_server.GetDocumentCount(), 0);
+	ASSERT_EQUAL(search_server.GetMemoryUsage().words, empty_usage.words);
+	ASSERT(search_server.FindTopDocuments("кот пёс хвост белый"s).empty());
+
+	search_server.AddDocument(7, "белый пёс"s, DocumentStatus::ACTUAL, { 1 });
+	ASSERT_EQUAL(search_server.FindTopDocuments("пёс"s).size(), 1);
+}
+
+void TestAddingDocumentsInBatch()
+{
+	const std::vector<std::string> texts = {
+		"белый кот и модный ошейник"s,
+		"пушистый кот пушистый хвост"s,
+		"ухоженный пёс выразительные глаза"s,
+		"ухоженный скворец евгений"s,
+		"белый пёс и пушистый кот"s
+	};
+
+	SearchServer sequential_server("и в на"s);
+	SearchServer batch_server("и в на"s);
+	sequential_server.AddDocument(10, "старый кот"s, DocumentStatus::ACTUAL, { 1 });
+	batch_server.AddDocument(10, "старый кот"s, DocumentStatus::ACTUAL, { 1 });
+	sequential_server.RemoveDocument(10);
+	batch_server.RemoveDocument(10);
+
+	std::vector<SearchServer::NewDocument> documents;
+	for (int id = 0; id < static_cast<int>(texts.size()); ++id)
+	{
+		sequential_server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id, 2 });
+		documents.push_back({ id, texts[id], DocumentStatus::ACTUAL, { id, 2 } });
+	}
+	batch_server.AddDocuments(std::execution::par, documents);
+
+	ASSERT_EQUAL(batch_server.GetDocumentCount(), sequential_server.GetDocumentCount());
+	for (const int document_id : sequential_server)
+	{
+		ASSERT(batch_server.GetWordFrequencies(document_id) == sequential_server.GetWordFrequencies(document_id));
+	}
+	const auto expected = sequential_server.FindTopDocuments("пушистый ухоженный кот -ошейник"s);
+	const auto actual = batch_server.FindTopDocuments("пушистый ухоженный кот -ошейник"s);
+	ASSERT_EQUAL(actual.size(), expected.size());
+	for (size_t i = 0; i < expected.size(); ++i)
+	{
+		ASSERT_EQUAL(actual[i].id, expected[i].id);
+		ASSERT_EQUAL(actual[i].rating, expected[i].rating);
+		ASSERT(std::abs(actual[i].relevance - expected[i].relevance) < EPSILON);
+	}
+
+	// Документы до первого ошибочного добавляются, остальные отбрасываются.
+	const std::vector<SearchServer::NewDocument> duplicate_batch = {
+		{ 20, "рыжий кот"sv, DocumentStatus::ACTUAL, { 1 } },
+		{ 21, "серый кот"sv, DocumentStatus::ACTUAL, { 1 } },
+		{ 20, "чёрный кот"sv, DocumentStatus::ACTUAL, { 1 } },
+		{ 22, "белый кот"sv, DocumentStatus::ACTUAL, { 1 } }
+	};
+	try
+	{
+		batch_server.AddDocuments(duplicate_batch);
+		ASSERT_HINT(false, "duplicate id in batch must throw"s);
+	}
+	catch (const std::invalid_argument&)
+	{
+	}
+	ASSERT_EQUAL(batch_server.GetDocumentCount(), 7);
+	ASSERT(batch_server.FindTopDocuments("чёрный"s).empty());
+
+	const std::vector<SearchServer::NewDocument> invalid_batch = {
+		{ 30, "рыжий кот"sv, DocumentStatus::ACTUAL, { 1 } },
+		{ 31, "серый к\x12от"sv, DocumentStatus::ACTUAL, { 1 } }
+	};
+	try
+	{
+		batch_server.AddDocuments(std::execution::seq, invalid_batch);
+		ASSERT_HINT(false, "special symbol in batch must throw"s);
+	}
+	catch (const std::invalid_argument&)
+	{
+	}
+	ASSERT_EQUAL(batch_server.GetDocumentCount(), 8);
+	ASSERT_EQUAL(batch_server.FindTopDocuments("рыжий"s).size(), 2);
+}
+
+void TestSavingAndOpeningIndex()
+{
+	SearchServer search_server("и в на"s);
+	search_server.AddDocument(1, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, { 8, -3 });
+	search_server.AddDocument(2, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+	search_server.AddDocument(3, "ухоженный пёс выразительные глаза"s, DocumentStatus::BANNED, { 5, -12, 2, 1 });
+	search_server.AddDocument(4, "ухоженный скворец евгений"s, DocumentStatus::ACTUAL, { 9 });
+	search_server.AddDocument(5, "пушистый пёс"s, DocumentStatus::ACTUAL, { 1 });
+	search_server.RemoveDocument(4);
+
+	const std::string path = "search_server_test_index.bin"s;
+	search_server.SaveIndex(path);
+	SearchServer opened_server = SearchServer::OpenIndex(path);
+
+	const auto check_same_results = [](const SearchServer& expected_server, const SearchServer& actual_server)
+		{
+			ASSERT_EQUAL(actual_server.GetDocumentCount(), expected_server.GetDocumentCount());
+			for (const auto* raw_query : { "пушистый ухоженный кот", "пёс -хвост", "и скворец", "белый пёс" })
+			{
+				const auto expected = expected_server.FindTopDocuments(raw_query);
+				const auto actual = actual_server.FindTopDocuments(std::execution::par, raw_query);
+				ASSERT_EQUAL(actual.size(), expected.size());
+				for (size_t i = 0; i < expected.size(); ++i)
+				{
+					ASSERT_EQUAL(actual[i].id, expected[i].id);
+					ASSERT_EQUAL(actual[i].rating, expected[i].rating);
+					ASSERT(std::abs(actual[i].relevance - expected[i].relevance) < EPSILON);
+				}
+			}
+			for (const int document_id : expected_server)
+			{
+				ASSERT(actual_server.GetWordFrequencies(document_id) == expected_server.GetWordFrequencies(document_id));
+				ASSERT(actual_server.MatchDocument("пушистый кот -ошейник"s, document_id)
+					== expected_server.MatchDocument("пушистый кот -ошейник"s, document_id));
+			}
+		};
+	check_same_results(search_server, opened_server);
+	ASSERT(opened_server.FindTopDocuments("и"s).empty());
+
+	// Открытый индекс можно изменять, исходный файл при этом не меняется.
+	for (auto* server : { &search_server, &opened_server })
+	{
+		server->RemoveDocument(2);
+		server->AddDocument(6, "пушистый скворец"s, DocumentStatus::ACTUAL, { 3 });
+		server->AddDocument(7, "модный пёс"s, DocumentStatus::ACTUAL, { 4 });
+	}
+	check_same_results(search_server, opened_server);
+	ASSERT_EQUAL(SearchServer::OpenIndex(path).GetDocumentCount(), 4);
+
+	// Испорченное содержимое секций обнаруживается при открытии, а не при поиске.
+	std::string file_data;
+	{
+		std::ifstream input(path, std::ios::binary);
+		file_data.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+	}
+	IndexFileHeader header;
+	std::memcpy(&header, file_data.data(), sizeof(header));
+	const std::string corrupted_path = "search_server_test_corrupted_index.bin"s;
+	const auto expect_open_failure = [&](uint64_t offset, int32_t value)
+		{
+			std::string corrupted = file_data;
+			std::memcpy(corrupted.data() + offset, &value, sizeof(value));
+			{
+				std::ofstream output(corrupted_path, std::ios::binary);
+				output.write(corrupted.data(), static_cast<std::streamsize>(corrupted.size()));
+			}
+			try
+			{
+				SearchServer::OpenIndex(corrupted_path);
+				ASSERT_HINT(false, "corrupted index must throw"s);
+			}
+			catch (const std::runtime_error&)
+			{
+			}
+		};
+	const int32_t document_count = static_cast<int32_t>(header.document_count);
+	const int32_t word_count = static_cast<int32_t>(header.word_count);
+	const int32_t free_ordinal = *reinterpret_cast<const int32_t*>(file_data.data() + header.free_ordinals_offset);
+	const int32_t first_id = *reinterpret_cast<const int32_t*>(file_data.data() + header.documents_offset);
+	expect_open_failure(header.postings_offset + offsetof(Posting, ordinal), document_count);
+	expect_open_failure(header.postings_offset + offsetof(Posting, ordinal), free_ordinal);
+	expect_open_failure(header.forward_entries_offset + offsetof(IndexForwardEntry, word_id), word_count);
+	expect_open_failure(header.free_ordinals_offset, document_count);
+	expect_open_failure(header.free_ordinals_offset, free_ordinal == 0 ? 1 : 0);
+	expect_open_failure(header.documents_offset + sizeof(IndexDocumentRecord) + offsetof(IndexDocumentRecord, id), first_id);
+	expect_open_failure(header.documents_offset + offsetof(IndexDocumentRecord, status), 7);
+	std::remove(corrupted_path.c_str());
+
+	std::remove(path.c_str());
+}
+
+void TestStringInternerAssignsDenseIds()
+{
+	StringInterner interner;
+	const int cat_id = interner.Intern("кот"sv);
+	const int dog_id = interner.Intern("пёс"sv);
+	ASSERT_EQUAL(cat_id, 0);
+	ASSERT_EQUAL(dog_id, 1);
+	ASSERT_EQUAL(interner.Intern(std::string("кот")), cat_id);
+	ASSERT_EQUAL(interner.Find("пёс"sv), dog_id);
+	ASSERT_EQUAL(interner.Find("скворец"sv), StringInterner::NOT_FOUND);
+	ASSERT_EQUAL(interner.Get(cat_id), "кот"sv);
+
+	const std::string external = "внешняя строка"s;
+	const int external_id = interner.InternExternal(external);
+	ASSERT_EQUAL(interner.Get(external_id).data(), external.data());
+
+	interner.Release(dog_id);
+	ASSERT_EQUAL(interner.Find("пёс"sv), StringInterner::NOT_FOUND);
+	ASSERT_EQUAL(interner.Intern("скворец"sv), dog_id);
+	ASSERT_EQUAL(interner.size(), 3);
+
+	// Строки не перемещаются при росте хранилища и освобождении соседей.
+	const std::string_view cat = interner.Get(cat_id);
+	std::vector<int> ids;
+	for (int i = 0; i < 20000; ++i)
+	{
+		ids.push_back(interner.Intern("слово"s + std::to_string(i)));
+	}
+	ASSERT_EQUAL(interner.Get(cat_id).data(), cat.data());
+	const size_t full_usage = interner.GetMemoryUsage();
+	for (const int id : ids)
+	{
+		interner.Release(id);
+	}
+	ASSERT(interner.GetMemoryUsage() < full_usage);
+	ASSERT_EQUAL(interner.Get(cat_id), "кот"sv);
+
+	for (const int id : { cat_id, dog_id, external_id })
+	{
+		interner.Release(id);
+	}
+	ASSERT(interner.empty());
+	ASSERT_EQUAL(interner.GetMemoryUsage(), StringInterner().GetMemoryUsage());
+}
+
+void TestSplittingIntoWordsDetectsControlCharacters()
+{
+	using namespace std::literals;
+	// Сравнивает разбиение с простым посимвольным на текстах длиннее блока.
+	const auto split_by_chars = [](std::string_view text)
+		{
+			std::vector<std::string_view> words;
+			size_t begin = 0;
+			for (size_t i = 0; i <= text.size(); ++i)
+			{
+				if (i == text.size() || text[i] == ' ')
+				{
+					if (i > begin)
+					{
+						words.push_back(text.substr(begin, i - begin));
+					}
+					begin = i + 1;
+				}
+			}
+			return words;
+		};
+
+	std::vector<std::string_view> words;
+	for (const std::string& text : { ""s, "   "s, "кот"s, "  белый кот и модный ошейник  "s,
+		"пушистый    кот пушистый хвост ухоженный пёс выразительные глаза"s,
+		std::string(40, 'a') + " "s + std::string(17, ' ') + "b"s })
+	{
+		ASSERT(SplitIntoWords(text, words));
+		ASSERT(words == split_by_chars(text));
+		ASSERT(!HasControlCharacters(text));
+	}
+
+	const std::string base = "пушистый кот пушистый хвост ухоженный пёс выразительные глаза"s;
+	for (size_t position = 0; position < base.size(); position += 5)
+	{
+		std::string text = base;
+		text[position] = '\x12';
+		ASSERT(!SplitIntoWords(text, words));
+		ASSERT(words == split_by_chars(text));
+		ASSERT(HasControlCharacters(text));
+	}
+
+	SearchServer search_server("и в на"s);
+	try
+	{
+		search_server.AddDocument(1, "длинный текст документа со скрытым \x01 символом"sv, DocumentStatus::ACTUAL, { 1 });
+		ASSERT_HINT(false, "control character in document must throw"s);
+	}
+	catch (const std::invalid_argument&)
+	{
+	}
+	try
+	{
+		search_server.FindTopDocuments("длинный запрос со скрытым сим\x1Fволом"sv);
+		ASSERT_HINT(false, "control character in query must throw"s);
+	}
+	catch (const std::invalid_argument&)
+	{
+	}
+	ASSERT_EQUAL(search_server.GetDocumentCount(), 0);
+}
+
+void TestQueryCacheInvalidatedOnIndexUpdate()
+{
+	using namespace std::literals;
+	SearchServer search_server("и в на"s);
+	search_server.AddDocument(1, "белый кот и модный ошейник"sv, DocumentStatus::ACTUAL, { 8, -3 });
+	search_server.AddDocument(2, "пушистый кот пушистый хвост"sv, DocumentStatus::ACTUAL, { 7, 2, 7 });
+	search_server.AddDocument(3, "ухоженный пёс выразительные глаза"sv, DocumentStatus::BANNED, { 5, -12, 2, 1 });
+	search_server.EnableQueryCache(2);
+
+	const std::vector<Document> expected = search_server.FindTopDocuments("кот пёс"sv);
+	ASSERT_EQUAL(search_server.GetQueryCacheStats().misses, 1);
+
+	// Порядок и повторы слов не влияют на ключ, а параллельный поиск использует тот же кеш.
+	ASSERT(search_server.FindTopDocuments("пёс кот кот"sv) == expected);
+	ASSERT(search_server.FindTopDocuments(std::execution::par, "кот пёс"sv) == expected);
+	ASSERT_EQUAL(search_server.GetQueryCacheStats().hits, 2);
+
+	// Статус и число результатов входят в ключ; запросы с предикатом не кешируются.
+	ASSERT_EQUAL(search_server.FindTopDocuments("кот пёс"sv, DocumentStatus::BANNED).size(), 1);
+	ASSERT_EQUAL(search_server.FindTopDocuments("кот пёс"sv, [](int, DocumentStatus, int)
+		{
+			return true;
+		}).size(), 3);
+	QueryCache::Stats stats = search_server.GetQueryCacheStats();
+	ASSERT_EQUAL(stats.misses, 2);
+	ASSERT_EQUAL(stats.size, 2);
+
+	ASSERT_EQUAL(search_server.FindTopDocuments("кот"sv, DocumentStatus::ACTUAL, 1).size(), 1);
+	stats = search_server.GetQueryCacheStats();
+	ASSERT_EQUAL(stats.evictions, 1);
+	ASSERT_EQUAL(stats.size, 2);
+
+	const uint64_t version = search_server.GetIndexVersion();
+	search_server.AddDocument(4, "кот кот"sv, DocumentStatus::ACTUAL, { 1 });
+	ASSERT(search_server.GetIndexVersion() > version);
+	ASSERT_EQUAL(search_server.FindTopDocuments("кот"sv, DocumentStatus::ACTUAL, 1)[0].id, 4);
+	ASSERT_EQUAL(search_server.GetQueryCacheStats().invalidations, 1);
+
+	search_server.RemoveDocument(4);
+	ASSERT_EQUAL(search_server.FindTopDocuments("кот"sv, DocumentStatus::ACTUAL, 1)[0].id, 2);
+	ASSERT_EQUAL(search_server.GetQueryCacheStats().invalidations, 2);
+
+	search_server.DisableQueryCache();
+	ASSERT(search_server.FindTopDocuments("кот пёс"sv) == ProcessQueries(search_server, { "кот пёс"s })[0]);
+	ASSERT_EQUAL(search_server.GetQueryCacheStats().hits, 0);
+}
+
+void TestQueryContextAvoidsAllocations()
+{
+	using namespace std::literals;
+	SearchServer search_server("и в на"s);
+	const std::vector<std::string> words = { "белый"s, "кот"s, "модный"s, "ошейник"s, "пушистый"s, "хвост"s, "пёс"s, "глаза"s };
+	for (int id = 0; id < 2000; ++id)
+	{
+		std::string text;
+		for (int i = 0; i < 6; ++i)
+		{
+			text += words[(id * 7 + i * 3 + id / 5) % words.size()] + " "s;
+		}
+		search_server.AddDocument(id, text, static_cast<DocumentStatus>(id % 3), { id % 11 });
+	}
+	search_server.SetPostingsCompression(true);
+
+	const std::vector<std::string> queries = { "кот пёс"s, "пушистый -хвост белый"s, "модный и ошейник глаза"s, "кот кот -белый"s };
+	SearchServer::QueryContext context;
+	for (const std::string& query : queries)
+	{
+		ASSERT(search_server.FindTopDocuments(context, query) == search_server.FindTopDocuments(query));
+		ASSERT(search_server.FindTopDocuments(context, query, DocumentStatus::BANNED, 20)
+			== search_server.FindTopDocuments(std::execution::par, query, DocumentStatus::BANNED, 20));
+	}
+
+#ifdef SEARCH_SERVER_COUNT_ALLOCATIONS
+	const size_t allocations_before = allocation_count;
+#endif
+	size_t result_count = 0;
+	for (int repeat = 0; repeat < 10; ++repeat)
+	{
+		for (const std::string& query : queries)
+		{
+			result_count += search_server.FindTopDocuments(context, query).size();
+			result_count += search_server.FindTopDocuments(context, query, DocumentStatus::BANNED, 20).size();
+			result_count += search_server.FindTopDocuments(context, query, [](int document_id, DocumentStatus, int)
+				{
+					return document_id % 2 == 0;
+				}).size();
+		}
+	}
+#ifdef SEARCH_SERVER_COUNT_ALLOCATIONS
+	const size_t allocations = allocation_count - allocations_before;
+	ASSERT_EQUAL(allocations, 0);
+#endif
+	ASSERT(result_count > 0);
+
+	// Кеш результатов тоже не выделяет память при попадании.
+	search_server.EnableQueryCache(16);
+	for (const std::string& query : queries)
+	{
+		search_server.FindTopDocuments(context, query);
+	}
+#ifdef SEARCH_SERVER_COUNT_ALLOCATIONS
+	const size_t cached_allocations_before = allocation_count;
+#endif
+	for (const std::string& query : queries)
+	{
+		search_server.FindTopDocuments(context, query);
+	}
+#ifdef SEARCH_SERVER_COUNT_ALLOCATIONS
+	const size_t cached_allocations = allocation_count - cached_allocations_before;
+	ASSERT_EQUAL(cached_allocations, 0);
+#endif
+	ASSERT_EQUAL(search_server.GetQueryCacheStats().hits, queries.size());
+}
+
+void TestMinusWordsFilterBeforeScoring()
+{
+	using namespace std::literals;
+	OrdinalBitmap bitmap;
+	bitmap.Reset(200);
+	ASSERT(bitmap.empty());
+	for (const int ordinal : { 0, 63, 64, 199 })
+	{
+		bitmap.Insert(ordinal);
+	}
+	ASSERT(bitmap.Contains(63) && bitmap.Contains(64) && bitmap.Contains(199));
+	ASSERT(!bitmap.Contains(1) && !bitmap.Contains(65));
+	bitmap.Reset(300);
+	ASSERT(bitmap.empty());
+	ASSERT(!bitmap.Contains(64) && !bitmap.Contains(299));
+
+	SearchServer search_server("и в на"s);
+	for (int id = 0; id < 500; ++id)
+	{
+		// Каждый третий документ содержит частое минус-слово.
+		const std::string text = "кот"s + (id % 3 == 0 ? " и пёс"s : ""s) + (id % 7 == 0 ? " хвост"s : " ошейник"s);
+		search_server.AddDocument(id, text, DocumentStatus::ACTUAL, { id });
+	}
+
+	SearchServer::QueryContext context;
+	const std::vector<Document> sequential = search_server.FindTopDocuments(context, "кот хвост -пёс"sv, DocumentStatus::ACTUAL, 100);
+	ASSERT(sequential == search_server.FindTopDocuments(std::execution::par, "кот хвост -пёс"sv, DocumentStatus::ACTUAL, 100));
+	ASSERT_EQUAL(sequential.size(), 100);
+	for (const Document& document : sequential)
+	{
+		ASSERT(document.id % 3 != 0);
+	}
+
+	// Битовая карта контекста очищается между запросами.
+	const std::vector<Document>& unfiltered = search_server.FindTopDocuments(context, "хвост"sv, DocumentStatus::ACTUAL, 100);
+	ASSERT_EQUAL(unfiltered.size(), 72);
+	ASSERT_EQUAL(unfiltered.front().id, 497);
+
+	ASSERT(std::get<0>(search_server.MatchDocument("кот -пёс"sv, 3)).empty());
+	ASSERT(std::get<0>(search_server.MatchDocument(std::execution::par, "кот -пёс -хвост"sv, 3)).empty());
+	ASSERT_EQUAL(std::get<0>(search_server.MatchDocument(std::execution::par, "кот -пёс -сом"sv, 4)).size(), 1);
+}
+
+void TestFilteringDocumentsWithDeclarativeFilter()
+{
+	using namespace std::literals;
+	const DocumentFilter filter = DocumentFilter()
+		.StatusIn({ DocumentStatus::ACTUAL, DocumentStatus::BANNED })
+		.RatingBetween(2, 8)
+		.IdModulo(3, 1);
+	const auto lambda = [](int document_id, DocumentStatus status, int rating)
+		{
+			return (status == DocumentStatus::ACTUAL || status == DocumentStatus::BANNED)
+				&& rating >= 2 && rating <= 8 && document_id % 3 == 1;
+		};
+
+	// Вычисление по столбцам совпадает с построчной проверкой, в том числе в хвосте массива.
+	std::vector<int> ids;
+	std::vector<DocumentStatus> statuses;
+	std::vector<int> ratings;
+	for (int id = 0; id < 203; ++id)
+	{
+		ids.push_back(id);
+		statuses.push_back(static_cast<DocumentStatus>(id % 4));
+		ratings.push_back(id % 11 - 1);
+	}
+	std::vector<uint64_t> bits;
+	for (const DocumentFilter& tested : { filter, DocumentFilter(), DocumentFilter().RatingBetween(0, 3),
+		DocumentFilter().StatusIn({ DocumentStatus::REMOVED }) })
+	{
+		tested.Evaluate(ids.data(), statuses.data(), ratings.data(), ids.size(), bits);
+		ASSERT_EQUAL(bits.size(), 4);
+		for (size_t i = 0; i < ids.size(); ++i)
+		{
+			ASSERT_EQUAL(((bits[i / 64] >> (i % 64)) & 1) == 1, tested(ids[i], statuses[i], ratings[i]));
+		}
+	}
+
+	SearchServer search_server("и в на"s);
+	for (int id = 0; id < 600; ++id)
+	{
+		const std::string text = id % 50 == 0 ? "редкий кот"s : "кот и пёс"s;
+		search_server.AddDocument(id, text, static_cast<DocumentStatus>(id / 7 % 3), { id % 13 });
+	}
+	// Частый и редкий запросы проверяют вычисление в битовую карту и построчную проверку.
+	for (const std::string_view query : { "кот"sv, "редкий"sv, "кот -пёс"sv })
+	{
+		const std::vector<Document> expected = search_server.FindTopDocuments(query, lambda, 50);
+		ASSERT(!expected.empty());
+		ASSERT(search_server.FindTopDocuments(query, filter, 50) == expected);
+		ASSERT(search_server.FindTopDocuments(std::execution::par, query, filter, 50) == expected);
+	}
+}
+
+void TestBatchedQueriesMatchSeparateQueries()
+{
+	using namespace std::literals;
+	const std::vector<std::string> words = { "кот"s, "пёс"s, "скворец"s, "ёж"s, "хвост"s, "нос"s, "глаза"s };
+	SearchServer search_server("и в на"s);
+	// Документов больше окна номеров, по которому идёт общий обход.
+	for (int id = 0; id < 20000; ++id)
+	{
+		std::string text;
+		for (size_t i = 0; i < words.size(); ++i)
+		{
+			if ((id * 7 + id / 3) % (i + 2) == 0)
+			{
+				text += words[i] + " и "s;
+			}
+		}
+		text += words[id % words.size()];
+		search_server.AddDocument(id, text, static_cast<DocumentStatus>(id % 3), { id % 17 });
+	}
+	search_server.RemoveDocument(5);
+
+	const std::vector<std::string> queries = {
+		"кот пёс"s, "пёс кот"s, "кот -хвост"s, "ёж нос глаза"s, "скворец -кот -пёс"s,
+		"кот пёс"s, "хвост -хвост"s, "неизвестное"s, "нос неизвестное -глаза"s, "и"s
+	};
+	ASSERT(ProcessQueriesBatched(search_server, queries) == ProcessQueries(search_server, queries));
+
+	const auto batched = search_server.FindTopDocumentsBatch(queries, DocumentStatus::BANNED, 20);
+	ASSERT_EQUAL(batched.size(), queries.size());
+	for (size_t i = 0; i < queries.size(); ++i)
+	{
+		ASSERT(batched[i] == search_server.FindTopDocuments(queries[i], DocumentStatus::BANNED, 20));
+	}
+
+	try
+	{
+		search_server.FindTopDocumentsBatch({ "кот"s, "--пёс"s });
+		ASSERT_HINT(false, "Invalid query in a batch must throw"s);
+	}
+	catch (const std::invalid_argument&)
+	{
+	}
+}
+
+void TestJoinedQueriesStreamInOrder()
+{
+	using namespace std::literals;
+	SearchServer search_server("и в на"s);
+	search_server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+	search_server.AddDocument(2, "пушистый пёс и модный ошейник"s, DocumentStatus::ACTUAL, { 1, 2 });
+	search_server.AddDocument(3, "большой кот модный ошейник "s, DocumentStatus::ACTUAL, { 1, 2, 8 });
+	search_server.AddDocument(4, "большой пёс скворец евгений"s, DocumentStatus::ACTUAL, { 1, 3, 2 });
+	search_server.AddDocument(5, "большой пёс скворец василий"s, DocumentStatus::ACTUAL, { 1, 1, 1 });
+	// Пустые ответы в начале, середине и конце не должны прерывать последовательность.
+	const std::vector<std::string> queries = {
+		"слон"s, "пушистый -пёс"s, "слон"s, "слон"s, "большой кот"s, "модный ошейник"s, "евгений"s, "слон"s
+	};
+
+	std::vector<Document> expected;
+	for (const auto& documents : ProcessQueries(search_server, queries))
+	{
+		expected.insert(expected.end(), documents.begin(), documents.end());
+	}
+	ASSERT_EQUAL(expected.size(), 8);
+
+	std::vector<Document> joined;
+	for (const Document& document : ProcessQueriesJoined(search_server, queries))
+	{
+		joined.push_back(document);
+	}
+	ASSERT(joined == expected);
+
+	for (const size_t window_size : { 1, 2, 3, 100 })
+	{
+		JoinedDocuments documents(search_server, queries, window_size);
+		ASSERT(std::vector<Document>(documents.begin(), documents.end()) == expected);
+
+		std::vector<Document> streamed;
+		size_t next_query = 0;
+		ProcessQueriesStreamed(search_server, queries, [&](size_t query_index, std::vector<Document>& result)
+			{
+				ASSERT_EQUAL(query_index, next_query++);
+				std::move(result.begin(), result.end(), std::back_inserter(streamed));
+			}, window_size);
+		ASSERT_EQUAL(next_query, queries.size());
+		ASSERT(streamed == expected);
+	}
+
+	ASSERT(ProcessQueriesJoined(search_server, {}).begin() == ProcessQueriesJoined(search_server, {}).end());
+
+	// Временный набор запросов живёт вместе с последовательностью, а её можно переместить.
+	joined.clear();
+	for (const Document& document : ProcessQueriesJoined(search_server, std::vector<std::string>(queries)))
+	{
+		joined.push_back(document);
+	}
+	ASSERT(joined == expected);
+
+	JoinedDocuments moved = ProcessQueriesJoined(search_server, std::vector<std::string>(queries));
+	JoinedDocuments documents(std::move(moved));
+	ASSERT(std::vector<Document>(documents.begin(), documents.end()) == expected);
+}
+
+void TestThreadPoolRunsNestedTasks()
+{
+	using namespace std::literals;
+	for (const size_t thread_count : { 1, 2, 4 })
+	{
+		ThreadPool pool(thread_count);
+		ASSERT_EQUAL(pool.GetThreadCount(), thread_count);
+
+		// Вложенный ParallelFor выполняется теми же потоками, без взаимной блокировки.
+		std::vector<std::atomic<int>> counters(100);
+		pool.ParallelFor(counters.size(), [&](size_t i)
+			{
+				pool.ParallelFor(i, [&](size_t) { ++counters[i]; });
+			});
+		for (size_t i = 0; i < counters.size(); ++i)
+		{
+			ASSERT_EQUAL(counters[i].load(), static_cast<int>(i));
+		}
+
+		try
+		{
+			pool.ParallelFor(1000, [](size_t i)
+				{
+					if (i == 500)
+					{
+						throw std::out_of_range("task failed"s);
+					}
+				});
+			ASSERT_HINT(false, "Exception from a task must reach the caller"s);
+		}
+		catch (const std::out_of_range&)
+		{
+		}
+	}
+
+	SearchServer search_server("и в на"s);
+	const std::vector<std::string> words = { "кот"s, "пёс"s, "скворец"s, "ёж"s, "хвост"s };
+	for (int id = 0; id < 100000; ++id)
+	{
+		search_server.AddDocument(id, words[id % 5] + " "s + words[id % 3] + " "s + words[id % 7 % 5],
+			DocumentStatus::ACTUAL, { id % 11 });
+	}
+	// Первые запросы крупные и делятся между потоками, последний выполняется целиком.
+	const std::vector<std::string> queries = { "кот пёс -ёж"s, "скворец хвост"s, "ёж"s, "хвост -кот"s, "несуществующее"s };
+	ThreadPool pool(4);
+	ASSERT(ProcessQueries(pool, search_server, queries) == ProcessQueries(search_server, queries));
+	for (const std::string& query : queries)
+	{
+		ASSERT(search_server.FindTopDocuments(pool, query, DocumentStatus::ACTUAL, 20)
+			== search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 20));
+	}
+}
+
+void TestRemovingDuplicates()
+{
+	using namespace std::literals;
+	SearchServer search_server("and with"s);
+	search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+	search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+	// Тот же набор слов, что у 2: порядок, повторы и стоп-слова не важны.
+	search_server.AddDocument(3, "curly hair funny pet funny"s, DocumentStatus::ACTUAL, { 1, 2 });
+	search_server.AddDocument(4, "funny pet and curly hair"s, DocumentStatus::BANNED, { 9 });
+	search_server.AddDocument(5, "funny funny pet and nasty nasty rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+	search_server.AddDocument(6, "funny pet and not very nasty rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+	search_server.AddDocument(7, "very nasty rat and not very funny pet"s, DocumentStatus::ACTUAL, { 1, 2 });
+	// Подмножество слов документа 1 — не дубликат.
+	search_server.AddDocument(8, "pet with rat and rat and rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+	search_server.AddDocument(9, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+
+	std::ostringstream output;
+	std::streambuf* const cout_buffer = std::cout.rdbuf(output.rdbuf());
+	RemoveDuplicates(search_server);
+	std::cout.rdbuf(cout_buffer);
+
+	ASSERT_EQUAL(output.str(), "Found duplicate document id 3\n"s
+		"Found duplicate document id 4\n"s
+		"Found duplicate document id 5\n"s
+		"Found duplicate document id 7\n"s);
+	ASSERT(std::vector<int>(search_server.begin(), search_server.end()) == std::vector<int>({ 1, 2, 6, 8, 9 }));
+	ASSERT(search_server.FindTopDocuments("curly"s).size() == 2);
+}
+
+void TestFindingNearDuplicates()
+{
+	using namespace std::literals;
+	std::vector<std::string> words;
+	for (int i = 0; i < 200; ++i)
+	{
+		words.push_back("word"s + std::to_string(i));
+	}
+	const auto make_text = [&words](int first_word, int word_count)
+		{
+			std::string text;
+			for (int i = 0; i < word_count; ++i)
+			{
+				text += words[first_word + i] + " "s;
+			}
+			return text;
+		};
+
+	SearchServer search_server("and with"s);
+	search_server.AddDocument(1, make_text(0, 20), DocumentStatus::ACTUAL, { 1 });
+	search_server.AddDocument(2, make_text(100, 20), DocumentStatus::ACTUAL, { 1 });
+	// 19 общих слов из 21: похожесть 0.9.
+	search_server.AddDocument(3, make_text(1, 20), DocumentStatus::ACTUAL, { 1 });
+	search_server.AddDocument(4, make_text(50, 20), DocumentStatus::ACTUAL, { 1 });
+	// Точный дубликат документа 2 с повторами и стоп-словами.
+	search_server.AddDocument(5, make_text(100, 20) + "and "s + make_text(100, 5), DocumentStatus::ACTUAL, { 1 });
+	// Половина слов документа 1: похожесть 0.5.
+	search_server.AddDocument(6, make_text(0, 10), DocumentStatus::ACTUAL, { 1 });
+	// 18 общих слов из 22 с документом 4: похожесть около 0.82.
+	search_server.AddDocument(7, make_text(52, 20), DocumentStatus::ACTUAL, { 1 });
+
+	const std::vector<std::vector<int>> expected = { { 1, 3 }, { 2, 5 }, { 4, 7 } };
+	ASSERT(FindNearDuplicates(search_server) == expected);
+	ASSERT(FindNearDuplicates(search_server, { 0.4 }) == std::vector<std::vector<int>>({ { 1, 3, 6 }, { 2, 5 }, { 4, 7 } }));
+	ASSERT(FindNearDuplicates(search_server, { 0.85 }) == std::vector<std::vector<int>>({ { 1, 3 }, { 2, 5 } }));
+
+	std::ostringstream output;
+	std::streambuf* const cout_buffer = std::cout.rdbuf(output.rdbuf());
+	RemoveNearDuplicates(search_server);
+	std::cout.rdbuf(cout_buffer);
+	ASSERT_EQUAL(output.str(), "Found near-duplicate document id 3\n"s
+		"Found near-duplicate document id 5\n"s
+		"Found near-duplicate document id 7\n"s);
+	ASSERT(std::vector<int>(search_server.begin(), search_server.end()) == std::vector<int>({ 1, 2, 4, 6 }));
+
+	// Одна полоса из одного хеша: почти все документы с общими словами попадают
+	// в одну крупную корзину, хотя попарно не похожи. Дубликаты в ней не соседи.
+	SearchServer mixed_server("and with"s);
+	const std::string common_text = make_text(150, 20);
+	for (int id = 1; id <= 40; ++id)
+	{
+		const std::string text = id == 12 || id == 33 ? "duplicate "s : "unique"s + std::to_string(id) + " "s;
+		mixed_server.AddDocument(id, common_text + text, DocumentStatus::ACTUAL, { 1 });
+	}
+	// Остальные пары похожи на 20 / 22 ≈ 0.91.
+	ASSERT(FindNearDuplicates(mixed_server, { 0.95, 1 }) == std::vector<std::vector<int>>({ { 12, 33 } }));
+}
+
+void TestPaginatingSearchResults()
+{
+	using namespace std::literals;
+	SearchServer search_server("и в на"s);
+	// Много документов с равной релевантностью и рейтингом: порядок задаёт id.
+	for (int id = 0; id < 60; ++id)
+	{
+		const std::string text = id % 4 == 0 ? "кот"s : id % 4 == 1 ? "кот пёс"s : id % 4 == 2 ? "кот кот пёс ёж"s : "ёж"s;
+		search_server.AddDocument(id, text, id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, { id % 3 });
+	}
+	const std::string query = "кот пёс"s;
+	const std::vector<Document> all_documents = search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 1000);
+	ASSERT_EQUAL(all_documents.size(), 36);
+
+	const size_t page_size = 7;
+	std::vector<Document> paged;
+	for (size_t offset = 0; offset < all_documents.size() + page_size; offset += page_size)
+	{
+		const auto page = search_server.FindTopDocumentsPage(query, DocumentStatus::ACTUAL, offset, page_size);
+		ASSERT(page.size() <= page_size);
+		paged.insert(paged.end(), page.begin(), page.end());
+	}
+	ASSERT(paged == all_documents);
+
+	std::vector<Document> continued = search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, page_size);
+	while (true)
+	{
+		const auto page = search_server.FindTopDocumentsAfter(query, DocumentStatus::ACTUAL, continued.back(), page_size);
+		if (page.empty())
+		{
+			break;
+		}
+		continued.insert(continued.end(), page.begin(), page.end());
+	}
+	ASSERT(continued == all_documents);
+
+	std::vector<Document> streamed;
+	size_t page_count = 0;
+	for (const auto& page : PaginateSearch(search_server, query, DocumentStatus::ACTUAL, page_size))
+	{
+		streamed.insert(streamed.end(), page.begin(), page.end());
+		++page_count;
+	}
+	ASSERT(streamed == all_documents);
+	ASSERT_EQUAL(page_count, 6);
+
+	const auto pages = Paginate(all_documents, page_size);
+	ASSERT_EQUAL(pages.size(), 6);
+	std::vector<Document> from_pages;
+	for (const auto& page : pages)
+	{
+		ASSERT(page.size() <= page_size);
+		from_pages.insert(from_pages.end(), page.begin(), page.end());
+	}
+	ASSERT(from_pages == all_documents);
+	ASSERT_EQUAL(pages.begin()->size(), page_size);
+	ASSERT_EQUAL(std::distance(pages.begin(), pages.end()), 6);
+
+	try
+	{
+		Paginate(all_documents, 0);
+		ASSERT_HINT(false, "Zero page size must throw"s);
+	}
+	catch (const std::invalid_argument&)
+	{
+	}
+}
+
+void TestRequestQueueCollectsStats()
+{
+	using namespace std::literals;
+	SearchServer search_server("и в на"s);
+	search_server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+	search_server.AddDocument(2, "пушистый пёс и модный ошейник"s, DocumentStatus::ACTUAL, { 1, 2, 3 });
+
+	// Пустые ответы считаются среди последних 1440 запросов.
+	RequestQueue request_queue(search_server);
+	for (int i = 0; i < 1439; ++i)
+	{
+		request_queue.AddFindRequest("пустой запрос"s);
+	}
+	request_queue.AddFindRequest("пушистый кот"s);
+	request_queue.AddFindRequest("модный пёс"s);
+	request_queue.AddFindRequest("пушистый"s, DocumentStatus::ACTUAL);
+	ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1437);
+	const RequestQueue::Stats recent = request_queue.GetStats(RequestQueue::Window::DAY);
+	ASSERT_EQUAL(recent.request_count, 1442);
+	ASSERT_EQUAL(recent.result_count, 5);
+
+	// Окна реального времени: запросы в разные минуты и часы.
+	RequestQueue stats_queue(search_server);
+	const RequestQueue::Clock::time_point start{ std::chrono::hours(24 * 365 * 50) };
+	for (int latency = 1; latency <= 100; ++latency)
+	{
+		stats_queue.RecordRequest(latency % 4 == 0 ? 0 : 3, std::chrono::microseconds(latency), start);
+	}
+
+	const RequestQueue::Stats minute = stats_queue.GetStats(RequestQueue::Window::MINUTE, start);
+	ASSERT_EQUAL(minute.request_count, 100);
+	ASSERT_EQUAL(minute.empty_count, 25);
+	ASSERT_EQUAL(minute.result_count, 225);
+	ASSERT(std::abs(minute.empty_rate - 0.25) < 1e-9);
+	ASSERT(minute.latency_p50 >= std::chrono::microseconds(50) && minute.latency_p50 <= std::chrono::microseconds(50 * 9 / 8));
+	ASSERT(minute.latency_p99 >= std::chrono::microseconds(99) && minute.latency_p99 <= std::chrono::microseconds(99 * 9 / 8));
+
+	stats_queue.RecordRequest(1, std::chrono::milliseconds(5), start + std::chrono::minutes(2));
+	ASSERT_EQUAL(stats_queue.GetStats(RequestQueue::Window::MINUTE, start + std::chrono::minutes(2)).request_count, 1);
+	ASSERT_EQUAL(stats_queue.GetStats(RequestQueue::Window::HOUR, start + std::chrono::minutes(2)).request_count, 101);
+
+	// Через два часа минутная корзина запроса переиспользуется, а часовые остаются.
+	stats_queue.RecordRequest(0, std::chrono::milliseconds(5), start + std::chrono::hours(2));
+	ASSERT_EQUAL(stats_queue.GetStats(RequestQueue::Window::HOUR, start + std::chrono::hours(2)).request_count, 1);
+	const RequestQueue::Stats day = stats_queue.GetStats(RequestQueue::Window::DAY, start + std::chrono::hours(2));
+	ASSERT_EQUAL(day.request_count, 102);
+	ASSERT(day.latency_p99 >= std::chrono::milliseconds(5));
+	ASSERT_EQUAL(stats_queue.GetStats(RequestQueue::Window::DAY, start + std::chrono::hours(30)).request_count, 0);
+
+	// Одновременная запись из нескольких потоков.
+	const RequestQueue::Clock::time_point later = start + std::chrono::hours(3);
+	stats_queue.RecordRequest(1, std::chrono::microseconds(10), later);
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 4; ++i)
+	{
+		threads.emplace_back([&stats_queue, later]()
+			{
+				for (int j = 0; j < 10000; ++j)
+				{
+					stats_queue.RecordRequest(j % 2, std::chrono::microseconds(j), later);
+				}
+			});
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+	const RequestQueue::Stats concurrent = stats_queue.GetStats(RequestQueue::Window::MINUTE, later);
+	ASSERT_EQUAL(concurrent.request_count, 40001);
+	ASSERT_EQUAL(concurrent.empty_count, 20000);
+}
+
+void TestProfilerAggregatesScopes()
+{
+	using namespace std::literals;
+	static const Profiler::Site scope_site("test.profiler.scope", Profiler::SiteKind::SCOPE);
+	static const Profiler::Site counter_site("test.profiler.counter", Profiler::SiteKind::COUNTER);
+	const auto find_scope = [](const Profiler::Report& report, const std::string& name)
+		{
+			return std::find_if(report.scopes.begin(), report.scopes.end(), [&name](const Profiler::ScopeStats& stats)
+				{
+					return stats.name == name;
+				});
+		};
+
+	// Замеры разных потоков складываются.
+	Profiler::Reset();
+	const Profiler::Clock::time_point start = Profiler::Clock::now();
+	for (int i = 0; i < 3; ++i)
+	{
+		Profiler::RecordScope(scope_site, start, start + std::chrono::nanoseconds(1000));
+	}
+	Profiler::RecordScope(scope_site, start, start + std::chrono::nanoseconds(100000));
+	Profiler::AddToCounter(counter_site, 5);
+	std::thread thread([start]()
+		{
+			Profiler::RecordScope(scope_site, start, start + std::chrono::nanoseconds(1000));
+			Profiler::AddToCounter(counter_site, 2);
+		});
+	thread.join();
+	{
+		Profiler::Scope scope(scope_site);
+	}
+
+	Profiler::Report report = Profiler::Collect();
+	auto stats = find_scope(report, "test.profiler.scope"s);
+	ASSERT(stats != report.scopes.end());
+	ASSERT_EQUAL(stats->count, 6);
+	ASSERT(stats->total_ns >= 104000);
+	ASSERT(stats->min_ns <= 1000);
+	ASSERT_EQUAL(stats->max_ns, 100000);
+	ASSERT(stats->GetPercentileNs(0.5) >= 1000 && stats->GetPercentileNs(0.5) < 2048);
+	ASSERT_EQUAL(stats->GetPercentileNs(1.0), 100000);
+	ASSERT_EQUAL(report.counters.size(), 1);
+	ASSERT_EQUAL(report.counters[0].name, "test.profiler.counter"s);
+	ASSERT_EQUAL(report.counters[0].value, 7);
+
+	std::ostringstream json;
+	Profiler::WriteJson(json);
+	ASSERT(json.str().find("{\"name\": \"test.profiler.scope\", \"count\": 6, "s) != std::string::npos);
+	ASSERT(json.str().find("{\"name\": \"test.profiler.counter\", \"value\": 7}"s) != std::string::npos);
+
+	// Сброс обнуляет замеры всех потоков.
+	Profiler::Reset();
+	report = Profiler::Collect();
+	ASSERT(find_scope(report, "test.profiler.scope"s) == report.scopes.end());
+	ASSERT(report.counters.empty());
+
+	// Трассировка пишет события, пока не заполнится буфер потока.
+	Profiler::EnableTrace(2);
+	for (int i = 0; i < 3; ++i)
+	{
+		Profiler::RecordScope(scope_site, start, start + std::chrono::nanoseconds(1500));
+	}
+	std::ostringstream trace;
+	Profiler::WriteChromeTrace(trace);
+	const std::string trace_text = trace.str();
+	ASSERT_EQUAL(trace_text.rfind("{\"traceEvents\": ["s, 0), 0);
+	size_t event_count = 0;
+	for (size_t position = trace_text.find("\"test.profiler.scope\""); position != std::string::npos;
+		position = trace_text.find("\"test.profiler.scope\"", position + 1))
+	{
+		++event_count;
+	}
+	ASSERT_EQUAL(event_count, 2);
+	ASSERT(trace_text.find("\"ph\": \"X\""s) != std::string::npos);
+	ASSERT(trace_text.find("\"dur\": 1.500}"s) != std::string::npos);
+	report = Profiler::Collect();
+	stats = find_scope(report, "test.profiler.scope"s);
+	ASSERT(stats != report.scopes.end());
+	ASSERT_EQUAL(stats->count, 3);
+
+	Profiler::EnableTrace(0);
+	std::ostringstream empty_trace;
+	Profiler::WriteChromeTrace(empty_trace);
+	ASSERT_EQUAL(empty_trace.str(), "{\"traceEvents\": [], \"displayTimeUnit\": \"ns\"}"s);
+
+#ifdef SEARCH_SERVER_PROFILE
+	// Короткий запрос пул выполняет последовательно, не разбирая его второй раз.
+	SearchServer search_server("и в на"s);
+	search_server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+	ThreadPool pool(2);
+	Profiler::Reset();
+	ASSERT_EQUAL(search_server.FindTopDocuments(pool, "пушистый кот"s).size(), 1);
+	report = Profiler::Collect();
+	stats = find_scope(report, "search.parse"s);
+	ASSERT(stats != report.scopes.end());
+	ASSERT_EQUAL(stats->count, 1);
+#endif
+}
+
 void TestSearchServer()
 {
 	RUN_TEST(TestExcludeStopWordsFromAddedDocumentContent);
@@ -188,6 +1673,32 @@ void TestSearchServer()
 	RUN_TEST(TestDocumentRatingComputing);
 	RUN_TEST(TestSortingDocuments);
 	RUN_TEST(TestTfIdfComputing);
+	RUN_TEST(TestTfIdfStaysCurrentAfterUpdates);
 	RUN_TEST(TestFindingDocumentsWithUserPredicate);
 	RUN_TEST(TestFindingDocumentsWithUserDocumentStatus);
+	RUN_TEST(TestAddingAndRemovingDocumentsInAnyOrder);
+	RUN_TEST(TestParallelSearchMatchesSequential);
+	RUN_TEST(TestFindingTopDocumentsWithCustomResultCount);
+	RUN_TEST(TestPrunedTopDocumentsMatchExhaustiveSearch);
+	RUN_TEST(TestCompressedPostingsGiveSameResults);
+	RUN_TEST(TestCompressedPostingsUpdateInMiddle);
+	RUN_TEST(TestConcurrentMapAccumulatesInParallel);
+	RUN_TEST(TestSnapshotReadsDuringUpdates);
+	RUN_TEST(TestRemovingDocumentsReclaimsWords);
+	RUN_TEST(TestAddingDocumentsInBatch);
+	RUN_TEST(TestSavingAndOpeningIndex);
+	RUN_TEST(TestStringInternerAssignsDenseIds);
+	RUN_TEST(TestSplittingIntoWordsDetectsControlCharacters);
+	RUN_TEST(TestQueryCacheInvalidatedOnIndexUpdate);
+	RUN_TEST(TestQueryContextAvoidsAllocations);
+	RUN_TEST(TestMinusWordsFilterBeforeScoring);
+	RUN_TEST(TestFilteringDocumentsWithDeclarativeFilter);
+	RUN_TEST(TestBatchedQueriesMatchSeparateQueries);
+	RUN_TEST(TestJoinedQueriesStreamInOrder);
+	RUN_TEST(TestThreadPoolRunsNestedTasks);
+	RUN_TEST(TestRemovingDuplicates);
+	RUN_TEST(TestFindingNearDuplicates);
+	RUN_TEST(TestPaginatingSearchResults);
+	RUN_TEST(TestRequestQueueCollectsStats);
+	RUN_TEST(TestProfilerAggregatesScopes);
 }
\ No newline at end of file
@@ -109,4 +109,56 @@ void TestFindingDocumentsWithUserDocumentStatus();
 
 void TestTfIdfComputing();
 
+void TestTfIdfStaysCurrentAfterUpdates();
+
+void TestAddingAndRemovingDocumentsInAnyOrder();
+
+void TestParallelSearchMatchesSequential();
+
+void TestFindingTopDocumentsWithCustomResultCount();
+
+void TestPrunedTopDocumentsMatchExhaustiveSearch();
+
+void TestCompressedPostingsGiveSameResults();
+
+void TestCompressedPostingsUpdateInMiddle();
+
+void TestConcurrentMapAccumulatesInParallel();
+
+void TestSnapshotReadsDuringUpdates();
+
+void TestRemovingDocumentsReclaimsWords();
+
+void TestAddingDocumentsInBatch();
+
+void TestSavingAndOpeningIndex();
+
+void TestStringInternerAssignsDenseIds();
+
+void TestSplittingIntoWordsDetectsControlCharacters();
+
+void TestQueryCacheInvalidatedOnIndexUpdate();
+
+void TestQueryContextAvoidsAllocations();
+
+void TestMinusWordsFilterBeforeScoring();
+
+void TestFilteringDocumentsWithDeclarativeFilter();
+
+void TestBatchedQueriesMatchSeparateQueries();
+
+void TestJoinedQueriesStreamInOrder();
+
+void TestThreadPoolRunsNestedTasks();
+
+void TestRemovingDuplicates();
+
+void TestFindingNearDuplicates();
+
+void TestPaginatingSearchResults();
+
+void TestRequestQueueCollectsStats();
+
+void TestProfilerAggregatesScopes();
+
 void TestSearchServer();
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include "thread_pool.h"
+#include <chrono>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+	// Пул и номер рабочего потока, которым является текущий поток.
+	thread_local const ThreadPool* current_pool = nullptr;
+	thread_local size_t current_worker = 0;
+
+	size_t GetHardwareThreadCount()
+	{
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+}
+
+ThreadPool::ThreadPool(size_t thread_count, bool pin_threads)
+	: thread_count_(thread_count == 0 ? GetHardwareThreadCount() : thread_count)
+{
+	for (size_t i = 0; i + 1 < thread_count_; ++i)
+	{
+		workers_.push_back(std::make_unique<Worker>());
+	}
+	for (size_t i = 0; i < workers_.size(); ++i)
+	{
+		threads_.emplace_back([this, i]() { WorkerLoop(i); });
+#ifdef __linux__
+		if (pin_threads)
+		{
+			// Ядро 0 остаётся вызывающему потоку.
+			cpu_set_t cpus;
+			CPU_ZERO(&cpus);
+			CPU_SET((i + 1) % GetHardwareThreadCount(), &cpus);
+			pthread_setaffinity_np(threads_.back().native_handle(), sizeof(cpus), &cpus);
+		}
+#else
+		(void)pin_threads;
+#endif
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock(sleep_mutex_);
+		stop_ = true;
+	}
+	wake_up_.notify_all();
+	for (std::thread& thread : threads_)
+	{
+		thread.join();
+	}
+}
+
+size_t ThreadPool::GetThreadCount() const
+{
+	return thread_count_;
+}
+
+void ThreadPool::RunJob(Job& job, size_t count, size_t grain_size)
+{
+	// Задач в несколько раз больше, чем потоков, чтобы было что перехватывать.
+	grain_size = std::max<size_t>(grain_size, 1);
+	const size_t max_task_count = std::min((count + grain_size - 1) / grain_size, thread_count_ * 4);
+	const size_t task_size = (count + max_task_count - 1) / max_task_count;
+	const size_t task_count = (count + task_size - 1) / task_size;
+	job.pending_tasks = task_count;
+
+	// Рабочий поток кладёт задачи в свою очередь, внешний — раздаёт по очереди всем.
+	const size_t worker_index = GetCurrentWorker();
+	{
+		std::lock_guard lock(sleep_mutex_);
+		queued_tasks_ += task_count - 1;
+	}
+	for (size_t task = 1; task < task_count; ++task)
+	{
+		Worker& worker = *workers_[worker_index != NO_WORKER ? worker_index : next_worker_++ % workers_.size()];
+		std::lock_guard lock(worker.mutex);
+		worker.tasks.push_back({ &job, task * task_size, std::min(count, (task + 1) * task_size) });
+	}
+	wake_up_.notify_all();
+
+	Execute({ &job, 0, task_size });
+	while (job.pending_tasks.load() > 0)
+	{
+		if (RunOneTask(worker_index))
+		{
+			continue;
+		}
+		std::unique_lock lock(job.mutex);
+		job.done.wait_for(lock, std::chrono::microseconds(100), [&job]() { return job.pending_tasks.load() == 0; });
+	}
+	// Последняя задача уменьшает счётчик под мьютексом: после его захвата
+	// задача уже не обращается к job, и job можно уничтожить.
+	std::lock_guard lock(job.mutex);
+	if (job.exception)
+	{
+		std::rethrow_exception(job.exception);
+	}
+}
+
+void ThreadPool::WorkerLoop(size_t worker_index)
+{
+	current_pool = this;
+	current_worker = worker_index;
+	while (true)
+	{
+		if (RunOneTask(worker_index))
+		{
+			continue;
+		}
+		std::unique_lock lock(sleep_mutex_);
+		wake_up_.wait(lock, [this]() { return stop_ || queued_tasks_.load() > 0; });
+		if (stop_ && queued_tasks_.load() == 0)
+		{
+			return;
+		}
+	}
+}
+
+bool ThreadPool::RunOneTask(size_t worker_index)
+{
+	Task task;
+	if (!PopTask(worker_index, task))
+	{
+		return false;
+	}
+	Execute(task);
+	return true;
+}
+
+bool ThreadPool::PopTask(size_t worker_index, Task& task)
+{
+	if (worker_index != NO_WORKER)
+	{
+		Worker& worker = *workers_[worker_index];
+		std::lock_guard lock(worker.mutex);
+		if (!worker.tasks.empty())
+		{
+			task = worker.tasks.back();
+			worker.tasks.pop_back();
+			--queued_tasks_;
+			return true;
+		}
+	}
+
+	const size_t first_victim = worker_index != NO_WORKER ? worker_index + 1 : 0;
+	for (size_t i = 0; i < workers_.size(); ++i)
+	{
+		const size_t victim_index = (first_victim + i) % workers_.size();
+		if (victim_index == worker_index)
+		{
+			continue;
+		}
+		Worker& victim = *workers_[victim_index];
+		std::lock_guard lock(victim.mutex);
+		if (!victim.tasks.empty())
+		{
+			task = victim.tasks.front();
+			victim.tasks.pop_front();
+			--queued_tasks_;
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::Execute(const Task& task)
+{
+	Job& job = *task.job;
+	try
+	{
+		job.run(job.function, task.first, task.last);
+	}
+	catch (...)
+	{
+		std::lock_guard lock(job.mutex);
+		if (!job.exception)
+		{
+			job.exception = std::current_exception();
+		}
+	}
+	std::lock_guard lock(job.mutex);
+	if (--job.pending_tasks == 0)
+	{
+		job.done.notify_all();
+	}
+}
+
+size_t ThreadPool::GetCurrentWorker() const
+{
+	return current_pool == this ? current_worker : NO_WORKER;
+}
+
+size_t GetThreadCount(const std::execution::parallel_policy&)
+{
+	return GetHardwareThreadCount();
+}
+
+size_t GetThreadCount(const ThreadPool& pool)
+{
+	return pool.GetThreadCount();
+}
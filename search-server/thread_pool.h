@@ -0,0 +1,146 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <execution>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+// Пул потоков с перехватом работы (work stealing).
+//
+// У каждого рабочего потока своя очередь задач: поток берёт задачи с её конца,
+// а простаивающие потоки забирают задачи из начала чужих очередей. Поток,
+// ожидающий окончания ParallelFor, не спит, а выполняет задачи сам, поэтому
+// вложенный параллелизм (параллельный запрос внутри параллельной обработки
+// запросов) не создаёт новых потоков и не приводит к взаимной блокировке.
+//
+// Пул из thread_count потоков запускает thread_count - 1 рабочих потоков:
+// последним участником считается вызывающий поток.
+class ThreadPool
+{
+public:
+
+	// thread_count == 0 — по числу аппаратных потоков. При pin_threads рабочие
+	// потоки закрепляются за ядрами (только в Linux).
+	explicit ThreadPool(size_t thread_count = 0, bool pin_threads = false);
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	~ThreadPool();
+
+	size_t GetThreadCount() const;
+
+	// Выполняет function(i) для каждого i из [0, count) и дожидается окончания.
+	// Индексы объединяются в задачи по grain_size и больше. Первое исключение
+	// из function выбрасывается в вызывающем потоке после окончания всех задач.
+	template <typename Function>
+	void ParallelFor(size_t count, Function function, size_t grain_size = 1);
+
+private:
+
+	// Общая часть одного вызова ParallelFor.
+	struct Job
+	{
+		void (*run)(const void* function, size_t first, size_t last);
+		const void* function;
+		std::atomic<size_t> pending_tasks{ 0 };
+		std::mutex mutex;
+		std::condition_variable done;
+		std::exception_ptr exception;
+	};
+
+	struct Task
+	{
+		Job* job;
+		size_t first;
+		size_t last;
+	};
+
+	struct alignas(64) Worker
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	void RunJob(Job& job, size_t count, size_t grain_size);
+
+	void WorkerLoop(size_t worker_index);
+
+	// Выполняет одну задачу из своей или чужой очереди; false, если задач нет.
+	bool RunOneTask(size_t worker_index);
+
+	bool PopTask(size_t worker_index, Task& task);
+
+	void Execute(const Task& task);
+
+	// Номер рабочего потока этого пула в текущем потоке или NO_WORKER.
+	size_t GetCurrentWorker() const;
+
+	static const size_t NO_WORKER = static_cast<size_t>(-1);
+
+	size_t thread_count_;
+	std::vector<std::unique_ptr<Worker>> workers_;
+	std::vector<std::thread> threads_;
+	std::atomic<size_t> next_worker_{ 0 };
+
+	std::mutex sleep_mutex_;
+	std::condition_variable wake_up_;
+	std::atomic<size_t> queued_tasks_{ 0 };
+	bool stop_ = false;
+};
+
+template <typename Function>
+void ThreadPool::ParallelFor(size_t count, Function function, size_t grain_size)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	if (workers_.empty() || count <= std::max<size_t>(grain_size, 1))
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			function(i);
+		}
+		return;
+	}
+
+	Job job;
+	job.run = [](const void* function, size_t first, size_t last)
+		{
+			const Function& typed_function = *static_cast<const Function*>(function);
+			for (size_t i = first; i < last; ++i)
+			{
+				typed_function(i);
+			}
+		};
+	job.function = &function;
+	RunJob(job, count, grain_size);
+}
+
+// Выполняет function(i) для i из [0, count) стандартной параллельной политикой или
+// в пуле потоков, чтобы один и тот же код поиска работал с обоими исполнителями.
+template <typename Function>
+void ParallelFor(const std::execution::parallel_policy&, size_t count, Function function)
+{
+	std::vector<size_t> indexes(count);
+	std::iota(indexes.begin(), indexes.end(), 0);
+	std::for_each(std::execution::par, indexes.begin(), indexes.end(), function);
+}
+
+template <typename Function>
+void ParallelFor(ThreadPool& pool, size_t count, Function function)
+{
+	pool.ParallelFor(count, function);
+}
+
+size_t GetThreadCount(const std::execution::parallel_policy&);
+
+size_t GetThreadCount(const ThreadPool& pool);
@@ -0,0 +1,91 @@
+#include "top_documents.h"
+#include <algorithm>
+
+bool IsBetterDocument(const Document& lhs, const Document& rhs)
+{
+	if (lhs > rhs)
+	{
+		return true;
+	}
+	if (rhs > lhs)
+	{
+		return false;
+	}
+	return lhs.id < rhs.id;
+}
+
+TopDocuments::TopDocuments(size_t max_count)
+	: max_count_(max_count)
+{
+	heap_.reserve(std::min<size_t>(max_count, 64));
+}
+
+void TopDocuments::Reset(size_t max_count)
+{
+	max_count_ = max_count;
+	heap_.clear();
+	has_cursor_ = false;
+}
+
+void TopDocuments::SetCursor(const Document& after)
+{
+	has_cursor_ = true;
+	cursor_ = after;
+}
+
+void TopDocuments::Push(const Document& document)
+{
+	if (max_count_ == 0 || (has_cursor_ && !IsBetterDocument(cursor_, document)))
+	{
+		return;
+	}
+	if (heap_.size() < max_count_)
+	{
+		heap_.push_back(document);
+		std::push_heap(heap_.begin(), heap_.end(), IsBetterDocument);
+	}
+	else if (IsBetterDocument(document, heap_.front()))
+	{
+		std::pop_heap(heap_.begin(), heap_.end(), IsBetterDocument);
+		heap_.back() = document;
+		std::push_heap(heap_.begin(), heap_.end(), IsBetterDocument);
+	}
+}
+
+void TopDocuments::Merge(const TopDocuments& other)
+{
+	for (const Document& document : other.heap_)
+	{
+		Push(document);
+	}
+}
+
+bool TopDocuments::IsFull() const
+{
+	return max_count_ > 0 && heap_.size() == max_count_;
+}
+
+const Document& TopDocuments::GetWorst() const
+{
+	return heap_.front();
+}
+
+size_t TopDocuments::size() const
+{
+	return heap_.size();
+}
+
+std::vector<Document> TopDocuments::Extract()
+{
+	std::sort_heap(heap_.begin(), heap_.end(), IsBetterDocument);
+	std::vector<Document> result = std::move(heap_);
+	heap_.clear();
+	return result;
+}
+
+void TopDocuments::Extract(std::vector<Document>& documents)
+{
+	std::sort_heap(heap_.begin(), heap_.end(), IsBetterDocument);
+	documents.assign(heap_.begin(), heap_.end());
+	heap_.clear();
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+#include "document.h"
+
+// Порядок выдачи: по убыванию релевантности (с точностью EPSILON), затем
+// по убыванию рейтинга, затем по возрастанию id для полностью равных документов.
+bool IsBetterDocument(const Document& lhs, const Document& rhs);
+
+// Ограниченная куча, хранящая лучшие max_count документов.
+// Вставка стоит O(log max_count), худший из отобранных документов доступен за O(1).
+class TopDocuments
+{
+public:
+
+	explicit TopDocuments(size_t max_count);
+
+	// Очищает кучу для нового поиска, сохраняя выделенную память. Сбрасывает курсор.
+	void Reset(size_t max_count);
+
+	// Курсор постраничной выдачи: документы, которые в порядке выдачи стоят не
+	// позже after, в кучу не попадают.
+	void SetCursor(const Document& after);
+
+	void Push(const Document& document);
+
+	void Merge(const TopDocuments& other);
+
+	bool IsFull() const;
+
+	const Document& GetWorst() const;
+
+	size_t size() const;
+
+	std::vector<Document> Extract();
+
+	// Записывает документы в порядке выдачи в documents, переиспользуя его память.
+	void Extract(std::vector<Document>& documents);
+
+private:
+
+	size_t max_count_;
+	std::vector<Document> heap_;
+	bool has_cursor_ = false;
+	Document cursor_;
+};